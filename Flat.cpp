@@ -11,6 +11,18 @@
 #include <math.h>
 #include <algorithm>
 #include <list>
+#include <vector>
+#include <unordered_map>
+#include <queue>
+#include <deque>
+#include <memory>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
+#include <chrono>
+#include <immintrin.h>
 #include <filesystem>
 
 #include "Lua/lua.hpp"
@@ -210,10 +222,18 @@ namespace Flat
 		Error() {}
 
 	public:
+		static bool bHeadless;
+
 		static void raise(LPCSTR lpMessage)
 		{
 			printf("[ERROR %s]: %s\n", (LPCSTR)Clock::localDate(), lpMessage);
 
+			if (bHeadless)
+			{
+				fflush(stdout);
+				ExitProcess(1);
+			}
+
 			if (MessageBox(nullptr, lpMessage, "Flat: Error.", MB_ICONERROR | MB_SYSTEMMODAL | MB_RETRYCANCEL) != IDRETRY)
 				ExitProcess(1);
 		}
@@ -227,6 +247,8 @@ namespace Flat
 		}
 	};
 
+	bool Error::bHeadless = false;
+
 	class Explorer
 	{
 	private:
@@ -481,6 +503,16 @@ namespace Flat
 			return min + (float)rand() / (float)(RAND_MAX / (max - min));
 		}
 
+		static void seed(UINT value)
+		{
+			srand(value);
+		}
+
+		static float quantize(float value, float step)
+		{
+			return roundf(value / step) * step;
+		}
+
 		static void luaModule(Namespace flat)
 		{
 			flat.beginNamespace("math")
@@ -494,6 +526,8 @@ namespace Flat
 				.addFunction<float, float, float, float>("clamp", &clamp)
 				.addFunction<float, float, float>("normalize", &normalize)
 				.addFunction<float, float, float>("random", &random)
+				.addFunction<void, UINT>("seed", &seed)
+				.addFunction<float, float, float>("quantize", &quantize)
 				.endNamespace()
 				.endNamespace();
 		}
@@ -618,6 +652,11 @@ namespace Flat
 			return (a + b) * 0.5f;
 		}
 
+		static float dot(Vector a, Vector b)
+		{
+			return a.x * b.x + a.y * b.y;
+		}
+
 		operator bool()
 		{
 			return length();
@@ -687,7 +726,7 @@ namespace Flat
 
 		void operator-=(Vector other)
 		{
-			operator+(-other);
+			*this = operator-(other);
 		}
 
 		void operator*=(Vector other)
@@ -715,6 +754,7 @@ namespace Flat
 				.addFunction<void, Vector, Vector>("clamp", &clamp)
 				.addFunction<void, Vector>("normalize", &normalize)
 				.addStaticFunction<Vector, Vector, Vector>("average", function(&average))
+				.addStaticFunction<float, Vector, Vector>("dot", function(&dot))
 				.addFunction<bool, Vector>("__eq", &operator==)
 				.addFunction<bool, Vector>("__lt", &operator<)
 				.addFunction<bool, Vector>("__le", &operator<=)
@@ -728,36 +768,537 @@ namespace Flat
 		}
 	};
 
+	class Atlas
+	{
+	private:
+		struct Segment
+		{
+			UINT x, y, nWidth;
+		};
+
+		struct Page
+		{
+			GLuint glId;
+			UINT nEntries;
+			vector<Segment> skyline;
+		};
+
+		struct Entry
+		{
+			LPBYTE lpPixels;
+			UINT nWidth, nHeight;
+			UINT nPage, x, y;
+		};
+
+		Atlas() {}
+
+		static vector<Page> pages;
+		static unordered_map<LPBYTE, Entry> entries;
+		static UINT nSize, nRequested;
+		static bool bRepack;
+
+		static void merge(vector<Segment>& skyline)
+		{
+			for (UINT i = 0; i + 1 < skyline.size();)
+				if (skyline[i].y == skyline[i + 1].y)
+				{
+					skyline[i].nWidth += skyline[i + 1].nWidth;
+					skyline.erase(skyline.begin() + i + 1);
+				}
+				else
+					i++;
+		}
+
+		static bool fit(Page& page, UINT nWidth, UINT nHeight, UINT& x, UINT& y)
+		{
+			vector<Segment>& skyline = page.skyline;
+			UINT nBest = UINT_MAX, nBestY = UINT_MAX;
+
+			for (UINT i = 0; i < skyline.size() && skyline[i].x + nWidth <= nSize; i++)
+			{
+				UINT nY = 0;
+
+				for (UINT j = i; j < skyline.size() && skyline[j].x < skyline[i].x + nWidth; j++)
+					nY = max(nY, skyline[j].y);
+
+				if (nY + nHeight <= nSize && nY < nBestY)
+				{
+					nBest = i;
+					nBestY = nY;
+				}
+			}
+
+			if (nBest == UINT_MAX)
+				return false;
+
+			x = skyline[nBest].x;
+			y = nBestY;
+
+			skyline.insert(skyline.begin() + nBest, Segment{ x, y + nHeight, nWidth });
+
+			for (UINT i = nBest + 1; i < skyline.size() && skyline[i].x < x + nWidth;)
+			{
+				UINT nShrink = x + nWidth - skyline[i].x;
+
+				if (skyline[i].nWidth <= nShrink)
+				{
+					skyline.erase(skyline.begin() + i);
+					continue;
+				}
+
+				skyline[i].x += nShrink;
+				skyline[i].nWidth -= nShrink;
+				break;
+			}
+
+			merge(skyline);
+			return true;
+		}
+
+		static void release(Entry& entry)
+		{
+			Page& page = pages[entry.nPage];
+
+			if (!--page.nEntries)
+			{
+				page.skyline.assign(1, Segment{ 0, 0, nSize });
+				return;
+			}
+
+			UINT nLeft = entry.x, nRight = entry.x + entry.nWidth + nPadding, nTop = entry.y + entry.nHeight + nPadding;
+
+			for (Segment& segment : page.skyline)
+				if (segment.x < nRight && segment.x + segment.nWidth > nLeft && segment.y != nTop)
+					return;
+
+			vector<Segment> skyline;
+
+			for (Segment& segment : page.skyline)
+			{
+				UINT nEnd = segment.x + segment.nWidth;
+
+				if (nEnd <= nLeft || segment.x >= nRight)
+				{
+					skyline.push_back(segment);
+					continue;
+				}
+
+				if (segment.x < nLeft)
+					skyline.push_back(Segment{ segment.x, segment.y, nLeft - segment.x });
+
+				skyline.push_back(Segment{ max(segment.x, nLeft), entry.y, min(nEnd, nRight) - max(segment.x, nLeft) });
+
+				if (nEnd > nRight)
+					skyline.push_back(Segment{ nRight, segment.y, nEnd - nRight });
+			}
+
+			merge(skyline);
+			page.skyline.swap(skyline);
+		}
+
+		static void upload(Entry& entry)
+		{
+			glBindTexture(GL_TEXTURE_2D, pages[entry.nPage].glId);
+			glTexSubImage2D(GL_TEXTURE_2D, 0, entry.x, entry.y, entry.nWidth, entry.nHeight, GL_RGBA, GL_UNSIGNED_BYTE, entry.lpPixels);
+		}
+
+		static bool insert(Entry& entry)
+		{
+			if (entry.nWidth + nPadding > nSize || entry.nHeight + nPadding > nSize)
+				return false;
+
+			for (UINT i = 0; i < pages.size(); i++)
+				if (fit(pages[i], entry.nWidth + nPadding, entry.nHeight + nPadding, entry.x, entry.y))
+				{
+					entry.nPage = i;
+					pages[i].nEntries++;
+					return true;
+				}
+
+			return false;
+		}
+
+		static void allocate()
+		{
+			Page page;
+			page.nEntries = 0;
+			page.skyline.push_back(Segment{ 0, 0, nSize });
+
+			vector<BYTE> blank(nSize * nSize * 4, 0);
+
+			glGenTextures(1, &page.glId);
+			glBindTexture(GL_TEXTURE_2D, page.glId);
+
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, nSize, nSize, 0, GL_RGBA, GL_UNSIGNED_BYTE, blank.data());
+
+			pages.push_back(page);
+		}
+
+		static void repack()
+		{
+			GLint nMaximum = 0;
+			glGetIntegerv(GL_MAX_TEXTURE_SIZE, &nMaximum);
+
+			clear();
+			nRequested = nPageSize;
+			nSize = min(nPageSize, (UINT)max(nMaximum, 64));
+
+			vector<Entry*> sorted;
+
+			for (auto& entry : entries)
+				sorted.push_back(&entry.second);
+
+			sort(sorted.begin(), sorted.end(), [](Entry* a, Entry* b)
+				{ return make_pair(a->nHeight, a->nWidth) > make_pair(b->nHeight, b->nWidth); });
+
+			for (Entry* lpEntry : sorted)
+			{
+				lpEntry->nPage = UINT_MAX;
+
+				if (insert(*lpEntry))
+					continue;
+
+				if (lpEntry->nWidth + nPadding > nSize || lpEntry->nHeight + nPadding > nSize)
+					continue;
+
+				allocate();
+				insert(*lpEntry);
+			}
+
+			for (Entry* lpEntry : sorted)
+				if (lpEntry->nPage != UINT_MAX)
+					upload(*lpEntry);
+
+			bRepack = false;
+			nRepacks++;
+		}
+
+		static void clear()
+		{
+			for (Page& page : pages)
+				glDeleteTextures(1, &page.glId);
+
+			pages.clear();
+		}
+
+	public:
+		static const UINT nPadding = 1;
+		static UINT nPageSize, nRepacks;
+
+		static bool locate(LPBYTE lpPixels, UINT nWidth, UINT nHeight, GLuint& glPage, UINT& x, UINT& y, UINT& nExtent)
+		{
+			auto found = entries.find(lpPixels);
+
+			if (found == entries.end())
+			{
+				Entry& entry = entries.insert(make_pair(lpPixels, Entry{ lpPixels, nWidth, nHeight, UINT_MAX, 0, 0 })).first->second;
+
+				if (nRequested == nPageSize && insert(entry))
+					upload(entry);
+				else if (nRequested != nPageSize || nWidth + nPadding <= nSize && nHeight + nPadding <= nSize)
+					bRepack = true;
+
+				found = entries.find(lpPixels);
+			}
+
+			Entry& entry = found->second;
+
+			if (entry.nPage == UINT_MAX)
+				return false;
+
+			glPage = pages[entry.nPage].glId;
+			x = entry.x;
+			y = entry.y;
+			nExtent = nSize;
+
+			return true;
+		}
+
+		static void update()
+		{
+			if (bRepack || nRequested != nPageSize && !entries.empty())
+				repack();
+		}
+
+		static void forget(LPBYTE lpPixels)
+		{
+			auto found = entries.find(lpPixels);
+
+			if (found == entries.end())
+				return;
+
+			if (found->second.nPage != UINT_MAX)
+				release(found->second);
+
+			entries.erase(found);
+		}
+
+		static UINT count()
+		{
+			return (UINT)pages.size();
+		}
+
+		static ULONGLONG bytes()
+		{
+			return (ULONGLONG)pages.size() * nSize * nSize * 4;
+		}
+
+		static void reset()
+		{
+			clear();
+			entries.clear();
+			nSize = 0;
+			nRequested = 0;
+			bRepack = false;
+		}
+	};
+
+	vector<Atlas::Page> Atlas::pages = vector<Atlas::Page>();
+	unordered_map<LPBYTE, Atlas::Entry> Atlas::entries = unordered_map<LPBYTE, Atlas::Entry>();
+	UINT Atlas::nSize = 0;
+	UINT Atlas::nRequested = 0;
+	bool Atlas::bRepack = false;
+	UINT Atlas::nPageSize = 2048;
+	UINT Atlas::nRepacks = 0;
+
+	class Textures
+	{
+	public:
+		struct Texture
+		{
+			LPBYTE lpPixels;
+			UINT nWidth, nHeight;
+			GLuint glId;
+			ULONGLONG nFrame;
+			bool bOwned;
+
+			~Texture()
+			{
+				lock_guard<mutex> guard(lock);
+				textures.erase(this);
+				releases.push_back(Release{ lpPixels, glId, size(*this), bOwned, nEpoch });
+			}
+		};
+
+	private:
+		struct Release
+		{
+			LPBYTE lpPixels;
+			GLuint glId;
+			ULONGLONG nBytes;
+			bool bFree;
+			ULONGLONG nEpoch;
+		};
+
+		Textures() {}
+
+		static unordered_map<Texture*, weak_ptr<Texture>> textures;
+		static vector<Release> releases;
+		static mutex lock;
+
+		static ULONGLONG size(Texture& texture)
+		{
+			return (ULONGLONG)texture.nWidth * texture.nHeight * 4;
+		}
+
+		static void evict(Texture& texture)
+		{
+			if (!texture.glId)
+				return;
+
+			glDeleteTextures(1, &texture.glId);
+			texture.glId = GL_NONE;
+
+			nResident -= size(texture);
+		}
+
+	public:
+		static ULONGLONG nBudget, nResident, nFrame;
+		static atomic<ULONGLONG> nEpoch;
+
+		static shared_ptr<Texture> create(LPBYTE lpPixels, UINT nWidth, UINT nHeight, bool bOwned)
+		{
+			shared_ptr<Texture> texture = shared_ptr<Texture>(new Texture{ lpPixels, nWidth, nHeight, GL_NONE, 0, bOwned });
+
+			lock_guard<mutex> guard(lock);
+			textures[texture.get()] = texture;
+
+			return texture;
+		}
+
+		static GLuint bind(Texture& texture)
+		{
+			texture.nFrame = nFrame;
+
+			if (texture.glId)
+				return texture.glId;
+
+			glGenTextures(1, &texture.glId);
+			glBindTexture(GL_TEXTURE_2D, texture.glId);
+
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, texture.nWidth, texture.nHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE, texture.lpPixels);
+
+			nResident += size(texture);
+			return texture.glId;
+		}
+
+		static void collect(ULONGLONG nSequence)
+		{
+			vector<Release> due;
+
+			{
+				lock_guard<mutex> guard(lock);
+				auto pending = partition(releases.begin(), releases.end(), [&](Release& release)
+					{ return release.nEpoch > nSequence; });
+
+				due.assign(pending, releases.end());
+				releases.erase(pending, releases.end());
+			}
+
+			for (Release& release : due)
+			{
+				if (release.glId)
+				{
+					glDeleteTextures(1, &release.glId);
+					nResident -= release.nBytes;
+				}
+
+				Atlas::forget(release.lpPixels);
+
+				if (release.bFree)
+					STBI_FREE(release.lpPixels);
+			}
+
+			if (nResident + Atlas::bytes() > nBudget)
+			{
+				vector<weak_ptr<Texture>> entries;
+				vector<shared_ptr<Texture>> resident;
+
+				{
+					lock_guard<mutex> guard(lock);
+
+					for (auto& entry : textures)
+						entries.push_back(entry.second);
+				}
+
+				for (weak_ptr<Texture>& entry : entries)
+				{
+					shared_ptr<Texture> texture = entry.lock();
+
+					if (texture && texture->glId && texture->nFrame < nFrame)
+						resident.push_back(texture);
+				}
+
+				sort(resident.begin(), resident.end(), [](shared_ptr<Texture>& a, shared_ptr<Texture>& b)
+					{ return a->nFrame < b->nFrame; });
+
+				for (UINT i = 0; i < resident.size() && nResident + Atlas::bytes() > nBudget; i++)
+					evict(*resident[i]);
+			}
+
+			nFrame++;
+		}
+
+		static UINT count()
+		{
+			lock_guard<mutex> guard(lock);
+			return (UINT)textures.size();
+		}
+	};
+
+	unordered_map<Textures::Texture*, weak_ptr<Textures::Texture>> Textures::textures = unordered_map<Textures::Texture*, weak_ptr<Textures::Texture>>();
+	vector<Textures::Release> Textures::releases = vector<Textures::Release>();
+	mutex Textures::lock;
+	atomic<ULONGLONG> Textures::nEpoch = 0;
+	ULONGLONG Textures::nBudget = 256ULL << 20;
+	ULONGLONG Textures::nResident = 0;
+	ULONGLONG Textures::nFrame = 0;
+
 	class Image
 	{
 	public:
 		LPBYTE lpPixels;
 		UINT nWidth, nHeight;
-		GLuint glId;
+		UINT nRegionX, nRegionY, nRegionWidth, nRegionHeight;
+		shared_ptr<Textures::Texture> lpTexture;
 
 		Image(LPCSTR lpFilePath)
 		{
 			lpPixels = stbi_load(lpFilePath, (int*)&nWidth, (int*)&nHeight, nullptr, 4);
-			glId = GL_NONE;
 
 			if (!lpPixels)
 				Error::raise(stbi_failure_reason());
+
+			lpTexture = Textures::create(lpPixels, nWidth, nHeight, true);
+			nRegionX = 0;
+			nRegionY = 0;
+			nRegionWidth = nWidth;
+			nRegionHeight = nHeight;
 		}
 
-		Image() : lpPixels(nullptr), nWidth(0), nHeight(0), glId(GL_NONE) {}
+		Image() : lpPixels(nullptr), nWidth(0), nHeight(0), nRegionX(0), nRegionY(0), nRegionWidth(0), nRegionHeight(0) {}
 
 		float diagonal()
 		{
 			return Geometry::length(nWidth, nHeight);
 		}
 
+		Image region(UINT x, UINT y, UINT nWidth, UINT nHeight)
+		{
+			UINT nFullWidth = nRegionWidth ? nRegionWidth : this->nWidth, nFullHeight = nRegionHeight ? nRegionHeight : this->nHeight;
+
+			if (!*this || !nWidth || !nHeight || x + nWidth > nFullWidth || y + nHeight > nFullHeight)
+				Error::raise("Invalid image region.");
+
+			Image image = *this;
+			image.nRegionX += x;
+			image.nRegionY += y;
+			image.nRegionWidth = nWidth;
+			image.nRegionHeight = nHeight;
+
+			return image;
+		}
+
+		GLuint locate(Vector& lower, Vector& upper)
+		{
+			UINT nLeft = nRegionX, nTop = nRegionY, nRight = nRegionX + (nRegionWidth ? nRegionWidth : nWidth), nBottom = nRegionY + (nRegionHeight ? nRegionHeight : nHeight);
+			UINT x, y, nExtent;
+			GLuint glPage;
+
+			if (Atlas::locate(lpPixels, nWidth, nHeight, glPage, x, y, nExtent))
+			{
+				lower = Vector((float)(x + nLeft) / nExtent, (float)(y + nTop) / nExtent);
+				upper = Vector((float)(x + nRight) / nExtent, (float)(y + nBottom) / nExtent);
+
+				return glPage;
+			}
+
+			lower = Vector((float)nLeft / nWidth, (float)nTop / nHeight);
+			upper = Vector((float)nRight / nWidth, (float)nBottom / nHeight);
+
+			return Textures::bind(*lpTexture);
+		}
+
 		void destroy()
 		{
-			STBI_FREE(lpPixels);
+			lpTexture.reset();
 			lpPixels = nullptr;
 			nWidth = 0;
 			nHeight = 0;
-			glId = GL_NONE;
+			nRegionX = 0;
+			nRegionY = 0;
+			nRegionWidth = 0;
+			nRegionHeight = 0;
 		}
 
 		operator bool()
@@ -768,13 +1309,13 @@ namespace Flat
 		operator LPCSTR()
 		{
 			LPSTR lpString = new CHAR[256];
-			sprintf_s(lpString, 256, "(%p, %u, %u, %u)", lpPixels, nWidth, nHeight, glId);
+			sprintf_s(lpString, 256, "(%p, %u, %u, %u, %u, %u, %u)", lpPixels, nWidth, nHeight, nRegionX, nRegionY, nRegionWidth, nRegionHeight);
 			return lpString;
 		}
 
 		bool operator==(Image other)
 		{
-			return lpPixels == other.lpPixels;
+			return lpPixels == other.lpPixels && nRegionX == other.nRegionX && nRegionY == other.nRegionY && nRegionWidth == other.nRegionWidth && nRegionHeight == other.nRegionHeight;
 		}
 
 		static void luaModule(Namespace flat)
@@ -783,6 +1324,11 @@ namespace Flat
 				.addConstructor<void (*)(LPCSTR)>()
 				.addData("width", &Image::nWidth, false)
 				.addData("height", &Image::nHeight, false)
+				.addData("regionX", &Image::nRegionX, false)
+				.addData("regionY", &Image::nRegionY, false)
+				.addData("regionWidth", &Image::nRegionWidth, false)
+				.addData("regionHeight", &Image::nRegionHeight, false)
+				.addFunction<Image, UINT, UINT, UINT, UINT>("region", &region)
 				.addFunction<void>("destroy", &destroy)
 				.addFunction<bool, Image>("__eq", &operator==)
 				.addFunction<LPCSTR>("__tostring", &operator LPCSTR)
@@ -822,69 +1368,39 @@ namespace Flat
 			return (a.center() - b.center()).angle();
 		}
 
-		/*static bool intersect(Transform a, Transform b)
+		static bool separate(Transform a, Transform b, Vector& translation)
 		{
-			Vector verticesA[] =
-			{
-				a.position.x, a.position.y + a.scale.y,
-				a.position + a.scale,
-				a.position.x + a.scale.x, a.position.y,
-				a.position
-			};
-
-			Vector verticesB[] =
-			{
-				b.position.x, b.position.y + b.scale.y,
-				b.position + b.scale,
-				b.position.x + b.scale.x, b.position.y,
-				b.position
-			};
-
-			for (BYTE i = 0; i < 2; i++)
-			{
-				Vector* vertices = (!i ? verticesA : verticesB);
-
-				for (BYTE j = 0; j < 4; j++)
-				{
-					INT l = (j + 1) % 4;
-					Vector p1 = vertices[j];
-					Vector p2 = vertices[l];
+			float cosineA = Geometry::cosine(a.rotation), sineA = Geometry::sine(a.rotation);
+			float cosineB = Geometry::cosine(b.rotation), sineB = Geometry::sine(b.rotation);
 
-					Vector normal(p2.y - p1.y, p2.x - p1.x);
+			float axesX[4] = { cosineA, -sineA, cosineB, -sineB };
+			float axesY[4] = { sineA, cosineA, sineB, cosineB };
+			float depths[4], distances[4];
 
-					float minA = INFINITY;
-					float maxA = -INFINITY;
+			Vector extentA = a.scale * 0.5f, extentB = b.scale * 0.5f;
+			Vector offset = b.center() - a.center();
 
-					for (BYTE k = 0; k < 4; k++)
-					{
-						float projected = normal.x * verticesA[k].x + normal.y * verticesA[k].y;
+			for (BYTE k = 0; k < 4; k++)
+			{
+				float radiusA = fabsf(extentA.x * (cosineA * axesX[k] + sineA * axesY[k])) + fabsf(extentA.y * (cosineA * axesY[k] - sineA * axesX[k]));
+				float radiusB = fabsf(extentB.x * (cosineB * axesX[k] + sineB * axesY[k])) + fabsf(extentB.y * (cosineB * axesY[k] - sineB * axesX[k]));
 
-						if (projected < minA)
-							minA = projected;
-						if (projected > maxA)
-							maxA = projected;
-					}
+				distances[k] = offset.x * axesX[k] + offset.y * axesY[k];
+				depths[k] = radiusA + radiusB - fabsf(distances[k]);
+			}
 
-					float minB = INFINITY;
-					float maxB = -INFINITY;
+			BYTE nAxis = 0;
 
-					for (BYTE k = 0; k < 4; k++)
-					{
-						float projected = normal.x * verticesB[k].x + normal.y * verticesB[k].y;
+			for (BYTE k = 1; k < 4; k++)
+				nAxis = depths[k] < depths[nAxis] ? k : nAxis;
 
-						if (projected < minB)
-							minB = projected;
-						if (projected > maxB)
-							maxB = projected;
-					}
+			if (depths[nAxis] <= 0.0f)
+				return false;
 
-					if (maxA < minB || maxB < minA)
-						return false;
-				}
-			}
+			translation = Vector(axesX[nAxis], axesY[nAxis]) * (distances[nAxis] > 0.0f ? -depths[nAxis] : depths[nAxis]);
 
 			return true;
-		}*/
+		}
 
 		static bool intersect(Transform a, Transform b)
 		{
@@ -959,19 +1475,67 @@ namespace Flat
 	class Tile
 	{
 	public:
+		ULONGLONG id, nOrder;
 		Transform transform;
 		Image texture;
-		bool dynamic, tangible, pushable;
+		bool dynamic, tangible, pushable, bullet, cached;
+		UINT category, mask;
+		INT layer;
 		float bounciness, friction;
 		Vector velocity;
+		bool sleeping, bSlept;
+		float rest;
+		Transform restTransform;
+		Vector restVelocity;
+		Transform lastTransform;
+
+		static float sleepVelocity, sleepTime, sleepMargin;
 
-		Tile(Transform transform, Image texture, bool dynamic, bool tangible, bool pushable, float bounciness, float friction, Vector velocity) : texture(texture), transform(transform), dynamic(dynamic), tangible(tangible), pushable(pushable), bounciness(bounciness), friction(friction), velocity(velocity) {}
+		Tile(Transform transform, Image texture, bool dynamic, bool tangible, bool pushable, float bounciness, float friction, Vector velocity) : id(0), nOrder(0), texture(texture), transform(transform), dynamic(dynamic), tangible(tangible), pushable(pushable), bullet(false), cached(false), category(1), mask(UINT_MAX), layer(0), bounciness(bounciness), friction(friction), velocity(velocity), sleeping(false), bSlept(false), rest(0.0f), lastTransform(transform) {}
 
 		Tile() : Tile(Transform(), Image(), false, false, false, 0.0f, 0.0f, Vector()) {}
 
-		static bool phase(Tile tile1, Tile tile2)
+		void sleep()
 		{
-			if (tile1.transform == tile2.transform || !tile1.tangible || !tile2.tangible || !tile1.dynamic && !tile2.dynamic)
+			sleeping = true;
+			bSlept = true;
+			velocity = Vector();
+			restTransform = transform;
+			restVelocity = velocity;
+		}
+
+		void wake()
+		{
+			sleeping = false;
+			rest = 0.0f;
+		}
+
+		bool asleep() const
+		{
+			return sleeping;
+		}
+
+		void suspend(bool bSleeping)
+		{
+			if (bSleeping)
+				sleep();
+			else
+				wake();
+		}
+
+		bool disturbed()
+		{
+			return !sleeping || transform != restTransform || velocity != restVelocity;
+		}
+
+		static bool interacts(Tile tile1, Tile tile2)
+		{
+			return (tile1.category & tile2.mask) && (tile2.category & tile1.mask);
+		}
+
+		static bool phase(Tile tile1, Tile tile2)
+		{
+			if (tile1.transform == tile2.transform || !tile1.tangible || !tile2.tangible || !tile1.dynamic && !tile2.dynamic)
 				return true;
 
 			return false;
@@ -998,14 +1562,27 @@ namespace Flat
 		{
 			flat.beginClass<Tile>("tile")
 				.addConstructor<void (*)(Transform, Image, bool, bool, bool, float, float, Vector)>()
+				.addData("id", &Tile::id, false)
 				.addData("transform", &Tile::transform)
 				.addData("texture", &Tile::texture)
 				.addData("dynamic", &Tile::dynamic)
 				.addData("tangible", &Tile::tangible)
 				.addData("pushable", &Tile::pushable)
+				.addData("bullet", &Tile::bullet)
+				.addData("cached", &Tile::cached)
+				.addData("category", &Tile::category)
+				.addData("mask", &Tile::mask)
+				.addData("layer", &Tile::layer)
 				.addData("bounciness", &Tile::bounciness)
 				.addData("friction", &Tile::friction)
 				.addData("velocity", &Tile::velocity)
+				.addProperty("sleeping", &Tile::asleep, &Tile::suspend)
+				.addStaticData("sleepVelocity", &Tile::sleepVelocity)
+				.addStaticData("sleepTime", &Tile::sleepTime)
+				.addStaticData("sleepMargin", &Tile::sleepMargin)
+				.addFunction<void>("sleep", &sleep)
+				.addFunction<void>("wake", &wake)
+				.addStaticFunction<bool, Tile, Tile>("interacts", function(&interacts))
 				.addStaticFunction<bool, Tile, Tile>("phase", function(&phase))
 				.addFunction<bool, Tile>("__eq", &operator==)
 				.addFunction<LPCSTR>("__tostring", &operator LPCSTR)
@@ -1014,499 +1591,1738 @@ namespace Flat
 		}
 	};
 
-	class Label
+	float Tile::sleepVelocity = 0.1f;
+	float Tile::sleepTime = 0.5f;
+	float Tile::sleepMargin = 0.01f;
+
+	class Tree
 	{
-	public:
-		Vector position;
-		float scale;
-		LPCSTR lpText;
-		ULONG uColor;
-		GLTtext* gltText;
+	private:
+		struct Node
+		{
+			Vector lower, upper;
+			INT nParent, nLeft, nRight, nHeight;
+			RefCountedPtr<Tile>* lpTile;
+			UINT nOrder, nCategory;
 
-		Label(Vector position, float scale, LPCSTR lpText, ULONG uColor) : position(position), scale(scale), lpText(lpText), uColor(uColor), gltText(nullptr) {}
+			bool leaf() const
+			{
+				return nLeft < 0;
+			}
+		};
 
-		Label() : Label(Vector(), 0.0f, nullptr, 0x00000000) {}
+		vector<Node> nodes;
+		INT nRoot, nFree;
+		float margin;
 
-		operator bool()
+		static float perimeter(Vector lower, Vector upper)
 		{
-			return scale && lpText;
+			return 2.0f * (upper.x - lower.x + upper.y - lower.y);
 		}
 
-		operator LPCSTR()
+		static bool overlap(const Node& node, Vector lower, Vector upper)
 		{
-			LPSTR lpString = new CHAR[256];
-			sprintf_s(lpString, 256, "(%s, %f, %s, 0x%X)", position.operator LPCSTR(), scale, lpText, uColor);
-			return lpString;
+			return node.lower.x <= upper.x && lower.x <= node.upper.x && node.lower.y <= upper.y && lower.y <= node.upper.y;
 		}
 
-		bool operator==(Label other)
+		INT allocate()
 		{
-			return position == other.position && scale == other.scale && lpText == other.lpText && uColor == other.uColor && gltText == other.gltText;
+			if (nFree < 0)
+			{
+				nodes.push_back(Node());
+				nFree = nodes.size() - 1;
+				nodes[nFree].nParent = -1;
+			}
+
+			INT nNode = nFree;
+			nFree = nodes[nNode].nParent;
+
+			nodes[nNode] = Node{ Vector(), Vector(), -1, -1, -1, 0, nullptr, 0, 0 };
+
+			return nNode;
 		}
 
-		void reset()
+		void release(INT nNode)
 		{
-			gltDeleteText(gltText);
-			gltText = nullptr;
+			nodes[nNode].nParent = nFree;
+			nodes[nNode].nHeight = -1;
+			nodes[nNode].lpTile = nullptr;
+			nFree = nNode;
 		}
 
-		static void luaModule(Namespace flat)
+		void join(INT nNode)
 		{
-			flat.beginClass<Label>("label")
-				.addConstructor<void (*)(Vector, float, LPCSTR, ULONG)>()
-				.addData("position", &Label::position)
-				.addData("scale", &Label::scale)
-				.addData("text", &Label::lpText)
-				.addData("color", &Label::uColor)
-				.addFunction<void>("reset", &reset)
-				.addFunction<bool, Label>("__eq", &operator==)
-				.addFunction<LPCSTR>("__tostring", &operator LPCSTR)
-				.endClass()
-				.endNamespace();
+			Node& node = nodes[nNode];
+			Node& left = nodes[node.nLeft];
+			Node& right = nodes[node.nRight];
+
+			node.lower = Vector(min(left.lower.x, right.lower.x), min(left.lower.y, right.lower.y));
+			node.upper = Vector(max(left.upper.x, right.upper.x), max(left.upper.y, right.upper.y));
+			node.nHeight = 1 + max(left.nHeight, right.nHeight);
+			node.nCategory = left.nCategory | right.nCategory;
 		}
-	};
 
-	enum class EventType : UINT
-	{
-		Update = 1,
-		Render,
-		Phase,
-		Collision,
-		Keyboard,
-		Mouse,
-		Network,
-		Invalid
-	};
+		INT rotate(INT nA, bool bLeft)
+		{
+			INT nB = bLeft ? nodes[nA].nLeft : nodes[nA].nRight;
+			INT nF = nodes[nB].nLeft, nG = nodes[nB].nRight;
 
-	class Event
-	{
-	public:
-		EventType type;
-		LPVOID lpParameters;
+			nodes[nB].nLeft = nA;
+			nodes[nB].nParent = nodes[nA].nParent;
+			nodes[nA].nParent = nB;
 
-		Event(EventType type, LPVOID lpParameters) : type(type), lpParameters(lpParameters) {}
-		Event() : type(EventType::Invalid), lpParameters(nullptr) {}
+			if (nodes[nB].nParent < 0)
+				nRoot = nB;
+			else if (nodes[nodes[nB].nParent].nLeft == nA)
+				nodes[nodes[nB].nParent].nLeft = nB;
+			else
+				nodes[nodes[nB].nParent].nRight = nB;
 
-		operator bool()
-		{
-			return type < EventType::Invalid;
-		}
+			INT nHigh = nodes[nF].nHeight > nodes[nG].nHeight ? nF : nG;
+			INT nLow = nHigh == nF ? nG : nF;
 
-		operator LPCSTR()
-		{
-			LPSTR lpString = new CHAR[256];
-			sprintf_s(lpString, 256, "(%u, %p)", type, lpParameters);
-			return lpString;
+			nodes[nB].nRight = nHigh;
+
+			if (bLeft)
+				nodes[nA].nLeft = nLow;
+			else
+				nodes[nA].nRight = nLow;
+
+			nodes[nLow].nParent = nA;
+
+			join(nA);
+			join(nB);
+
+			return nB;
 		}
 
-		bool operator==(Event other) const
+		INT balance(INT nA)
 		{
-			return type == other.type && lpParameters == other.lpParameters;
+			if (nodes[nA].leaf() || nodes[nA].nHeight < 2)
+				return nA;
+
+			INT nBalance = nodes[nodes[nA].nRight].nHeight - nodes[nodes[nA].nLeft].nHeight;
+
+			if (nBalance > 1)
+				return rotate(nA, false);
+
+			if (nBalance < -1)
+				return rotate(nA, true);
+
+			return nA;
 		}
 
-		void destroy()
+		void insertLeaf(INT nLeaf)
 		{
-			if (lpParameters)
+			if (nRoot < 0)
 			{
-				delete[] lpParameters;
-				lpParameters = nullptr;
+				nRoot = nLeaf;
+				nodes[nRoot].nParent = -1;
+				return;
 			}
 
-			type = EventType::Invalid;
-		}
-	};
+			Vector lower = nodes[nLeaf].lower, upper = nodes[nLeaf].upper;
+			INT nIndex = nRoot;
 
-	class Hook
-	{
-	public:
-		EventType type;
-		LuaRef function;
+			while (!nodes[nIndex].leaf())
+			{
+				const Node& node = nodes[nIndex];
 
-		Hook(EventType type, LuaRef function) : type(type), function(function) {}
-		Hook() : type(EventType::Invalid), function(nullptr) {}
+				Vector joinedLower(min(node.lower.x, lower.x), min(node.lower.y, lower.y));
+				Vector joinedUpper(max(node.upper.x, upper.x), max(node.upper.y, upper.y));
 
-		operator bool()
-		{
-			return type < EventType::Invalid;
-		}
+				float cost = 2.0f * perimeter(joinedLower, joinedUpper);
+				float inheritance = 2.0f * (perimeter(joinedLower, joinedUpper) - perimeter(node.lower, node.upper));
 
-		operator LPCSTR()
-		{
-			LPSTR lpString = new CHAR[256];
-			sprintf_s(lpString, 256, "(%u, %p)", type, function.tostring());
-			return lpString;
-		}
+				float childCost[2];
 
-		bool operator==(Hook other) const
-		{
-			return type == other.type && function.operator==(other.function);
-		}
-	};
+				for (BYTE i = 0; i < 2; i++)
+				{
+					const Node& child = nodes[!i ? node.nLeft : node.nRight];
 
-	class Lua
-	{
-	private:
-		lua_State* L;
+					Vector childLower(min(child.lower.x, lower.x), min(child.lower.y, lower.y));
+					Vector childUpper(max(child.upper.x, upper.x), max(child.upper.y, upper.y));
 
-	public:
-		Lua()
-		{
-			L = luaL_newstate();
-			luaL_openlibs(L);
+					childCost[i] = perimeter(childLower, childUpper) + inheritance;
 
-			lua_gc(L, LUA_GCSTOP);
-			luaL_dostring(L, "collectgarbage = nil");
+					if (!child.leaf())
+						childCost[i] -= perimeter(child.lower, child.upper);
+				}
 
-			getGlobalNamespace(L).beginNamespace("flat").addConstant("version", FLAT_VERSION_STRING).endNamespace();
-		}
+				if (cost < childCost[0] && cost < childCost[1])
+					break;
 
-		template <typename... Args>
-		void call(LuaRef& function, Args &&...args)
-		{
-			try
-			{
-				function(args...);
+				nIndex = childCost[0] < childCost[1] ? node.nLeft : node.nRight;
 			}
-			catch (exception e)
+
+			INT nSibling = nIndex;
+			INT nOldParent = nodes[nSibling].nParent;
+			INT nNewParent = allocate();
+
+			nodes[nNewParent].nParent = nOldParent;
+			nodes[nNewParent].nLeft = nSibling;
+			nodes[nNewParent].nRight = nLeaf;
+			nodes[nSibling].nParent = nNewParent;
+			nodes[nLeaf].nParent = nNewParent;
+
+			if (nOldParent < 0)
+				nRoot = nNewParent;
+			else if (nodes[nOldParent].nLeft == nSibling)
+				nodes[nOldParent].nLeft = nNewParent;
+			else
+				nodes[nOldParent].nRight = nNewParent;
+
+			for (nIndex = nNewParent; nIndex >= 0; nIndex = nodes[nIndex].nParent)
 			{
-				Error::raise(e.what());
+				nIndex = balance(nIndex);
+				join(nIndex);
 			}
 		}
 
-		void loadFile(LPCSTR lpFilePath)
+		void removeLeaf(INT nLeaf)
 		{
-			if (luaL_dofile(L, lpFilePath) != LUA_OK)
-				Error::raise(lua_tostring(L, -1));
-		}
+			if (nLeaf == nRoot)
+			{
+				nRoot = -1;
+				return;
+			}
 
-		void loadModule(void (*lpModule)(Namespace))
-		{
-			try
+			INT nParent = nodes[nLeaf].nParent;
+			INT nGrandParent = nodes[nParent].nParent;
+			INT nSibling = nodes[nParent].nLeft == nLeaf ? nodes[nParent].nRight : nodes[nParent].nLeft;
+
+			if (nGrandParent < 0)
 			{
-				lpModule(getGlobalNamespace(L).beginNamespace("flat"));
+				nRoot = nSibling;
+				nodes[nSibling].nParent = -1;
+				release(nParent);
+				return;
 			}
-			catch (exception e)
+
+			if (nodes[nGrandParent].nLeft == nParent)
+				nodes[nGrandParent].nLeft = nSibling;
+			else
+				nodes[nGrandParent].nRight = nSibling;
+
+			nodes[nSibling].nParent = nGrandParent;
+			release(nParent);
+
+			for (INT nIndex = nGrandParent; nIndex >= 0; nIndex = nodes[nIndex].nParent)
 			{
-				Error::raise(e.what());
+				nIndex = balance(nIndex);
+				join(nIndex);
 			}
 		}
 
-		void collect()
-		{
-			lua_gc(L, LUA_GCCOLLECT);
-		}
+	public:
+		Tree(float margin) : nRoot(-1), nFree(-1), margin(margin) {}
 
-		void destroy()
-		{
-			lua_close(L);
-			L = nullptr;
-		}
+		Tree() : Tree(0.1f) {}
 
-		operator bool()
+		static void bounds(Transform transform, Vector& lower, Vector& upper)
 		{
-			return L;
+			if (transform.rotation)
+			{
+				float cosine = fabsf(Geometry::cosine(transform.rotation)), sine = fabsf(Geometry::sine(transform.rotation));
+				Vector extent = Vector(fabsf(transform.scale.x), fabsf(transform.scale.y)) * 0.5f;
+				extent = Vector(extent.x * cosine + extent.y * sine, extent.x * sine + extent.y * cosine);
+
+				lower = transform.center() - extent;
+				upper = transform.center() + extent;
+				return;
+			}
+
+			Vector corner = transform.position + transform.scale;
+
+			lower = Vector(min(transform.position.x, corner.x), min(transform.position.y, corner.y));
+			upper = Vector(max(transform.position.x, corner.x), max(transform.position.y, corner.y));
 		}
 
-		bool operator==(Lua other)
+		INT insert(RefCountedPtr<Tile>* lpTile)
 		{
-			return L == other.L;
-		}
-	};
+			INT nLeaf = allocate();
 
-	class Console
-	{
-	private:
-		static bool bRunning;
+			bounds((*lpTile)->transform, nodes[nLeaf].lower, nodes[nLeaf].upper);
+			nodes[nLeaf].lower -= Vector(margin);
+			nodes[nLeaf].upper += Vector(margin);
+			nodes[nLeaf].lpTile = lpTile;
+			nodes[nLeaf].nCategory = (*lpTile)->category;
 
-		Console() {}
+			insertLeaf(nLeaf);
 
-	public:
-		static bool running()
-		{
-			return bRunning;
+			return nLeaf;
 		}
 
-		static void destroy()
+		void remove(INT nProxy)
 		{
-			if (!bRunning || !ShowWindow(GetConsoleWindow(), SW_HIDE) || !FreeConsole())
-				Error::raise("Failed to destroy console.");
-
-			bRunning = false;
+			removeLeaf(nProxy);
+			release(nProxy);
 		}
 
-		static void allocate()
+		bool move(INT nProxy)
 		{
-			if (bRunning)
-				Error::raise("Failed to allocate console.");
+			if (nodes[nProxy].nCategory != (*nodes[nProxy].lpTile)->category)
+			{
+				nodes[nProxy].nCategory = (*nodes[nProxy].lpTile)->category;
 
-			if (!AllocConsole())
-				Error::raise("Failed to allocate console.");
+				for (INT nIndex = nodes[nProxy].nParent; nIndex >= 0; nIndex = nodes[nIndex].nParent)
+					join(nIndex);
+			}
 
-			freopen_s((FILE**)stdin, "CONIN$", "r", stdin);
-			freopen_s((FILE**)stderr, "CONOUT$", "w", stderr);
-			freopen_s((FILE**)stdout, "CONOUT$", "w", stdout);
+			Vector lower, upper;
+			bounds((*nodes[nProxy].lpTile)->transform, lower, upper);
 
-			bRunning = true;
+			Node& node = nodes[nProxy];
+
+			if (node.lower.x <= lower.x && node.lower.y <= lower.y && upper.x <= node.upper.x && upper.y <= node.upper.y)
+				return false;
+
+			removeLeaf(nProxy);
+
+			nodes[nProxy].lower = lower - Vector(margin);
+			nodes[nProxy].upper = upper + Vector(margin);
+
+			insertLeaf(nProxy);
+
+			return true;
 		}
 
-		static void log(LPCSTR lpMessage)
+		void clear()
 		{
-			printf("[LOG %s]: %s\n", (LPCSTR)Clock::localDate(), lpMessage);
+			nodes.clear();
+			nRoot = -1;
+			nFree = -1;
 		}
 
-		static void print(LPCSTR lpMessage)
+		RefCountedPtr<Tile>* tile(INT nProxy)
 		{
-			printf("%s\n", lpMessage);
+			return nodes[nProxy].lpTile;
 		}
 
-		static void luaModule(Namespace flat)
+		UINT& order(INT nProxy)
 		{
-			flat.beginNamespace("console")
-				.addVariable("running", &bRunning, false)
-				.addFunction<void>("allocate", &Console::allocate)
-				.addFunction<void>("destroy", &Console::destroy)
-				.addFunction<void, LPCSTR>("log", &Console::log)
-				.addFunction<void, LPCSTR>("print", &Console::print)
-				.endNamespace()
-				.endNamespace();
+			return nodes[nProxy].nOrder;
 		}
-	};
 
-	bool Console::bRunning = false;
+		template <typename Callback>
+		void query(Vector lower, Vector upper, Callback callback, UINT nMask = UINT_MAX)
+		{
+			if (nRoot < 0)
+				return;
 
-	class Dispatcher
-	{
-	private:
-		Dispatcher() {}
+			vector<INT> stack(1, nRoot);
 
-		static list<Event> events;
-		static list<Hook> hooks;
+			while (!stack.empty())
+			{
+				INT nIndex = stack.back();
+				stack.pop_back();
 
-	public:
-		static void hook(UINT type, LuaRef function)
-		{
-			Hook hook((EventType)type, function);
+				const Node& node = nodes[nIndex];
 
-			if (!hook)
-				Error::raise("Invalid hook.");
+				if (!(node.nCategory & nMask) || !overlap(node, lower, upper))
+					continue;
 
-			hooks.push_back(hook);
+				if (node.leaf())
+					callback(nIndex);
+				else
+				{
+					stack.push_back(node.nLeft);
+					stack.push_back(node.nRight);
+				}
+			}
 		}
 
-		static void unhook(UINT type, LuaRef function)
+		static bool clip(Vector lower, Vector upper, Vector from, Vector direction, float& fraction)
 		{
-			for_each(hooks.begin(), hooks.end(), [&](Hook& hook)
-				{ if (hook.type == (EventType)type && hook.function.operator==(function)) hook.type = EventType::Invalid; });
-		}
+			float entry = 0.0f, exit = 1.0f;
 
-		static void sendEvent(EventType type, LPVOID lpParameters)
-		{
-			Event event(type, lpParameters);
+			for (BYTE i = 0; i < 2; i++)
+			{
+				float origin = !i ? from.x : from.y;
+				float delta = !i ? direction.x : direction.y;
+				float low = !i ? lower.x : lower.y;
+				float high = !i ? upper.x : upper.y;
 
-			if (!event)
-				Error::raise("Invalid event.");
+				if (fabsf(delta) < Math::epsilon)
+				{
+					if (origin < low || origin > high)
+						return false;
 
-			events.push_back(event);
+					continue;
+				}
+
+				float t1 = (low - origin) / delta;
+				float t2 = (high - origin) / delta;
+
+				entry = max(entry, min(t1, t2));
+				exit = min(exit, max(t1, t2));
+
+				if (entry > exit)
+					return false;
+			}
+
+			fraction = entry;
+			return true;
 		}
 
-		static void pollEvents(Lua& lua, EventType type)
+		template <typename Callback>
+		void raycast(Vector from, Vector to, Callback callback, UINT nMask = UINT_MAX)
 		{
-			if (type >= EventType::Invalid)
-			{
-				hooks.remove_if([&](Hook& hook)
-					{ return !hook; });
-				events.remove_if([&](Event& event)
-					{ return !event; });
+			if (nRoot < 0)
 				return;
-			}
 
-			try
-			{
-				for (Event& event : events)
-					if (event.type == type)
-					{
-						for (Hook& hook : hooks)
-							if (hook.type == type)
-								switch (type)
-								{
-								case EventType::Update:
-									lua.call(hook.function);
-									break;
-								case EventType::Render:
-									lua.call(hook.function);
-									break;
-								case EventType::Phase:
-									lua.call(hook.function, *((RefCountedPtr<Tile> **)event.lpParameters)[0], *((RefCountedPtr<Tile> **)event.lpParameters)[1]);
-									break;
-								case EventType::Collision:
-									lua.call(hook.function, *((RefCountedPtr<Tile> **)event.lpParameters)[0], *((RefCountedPtr<Tile> **)event.lpParameters)[1], *((Vector**)event.lpParameters)[2]);
-									break;
-								case EventType::Keyboard:
-									lua.call(hook.function, ((UINT*)event.lpParameters)[0], ((UINT*)event.lpParameters)[1]);
-									break;
-								case EventType::Mouse:
-									lua.call(hook.function, ((UINT*)event.lpParameters)[0], ((UINT*)event.lpParameters)[1]);
-									break;
-								case EventType::Network:
-									lua.call(hook.function, ((UINT*)event.lpParameters)[0]);
-									break;
-								}
+			Vector direction = to - from;
+			vector<INT> stack(1, nRoot);
 
-						event.destroy();
-					}
-			}
-			catch (exception e)
+			while (!stack.empty())
 			{
-				Error::raise(e.what());
+				INT nIndex = stack.back();
+				stack.pop_back();
+
+				const Node& node = nodes[nIndex];
+				float fraction;
+
+				if (!(node.nCategory & nMask) || !clip(node.lower, node.upper, from, direction, fraction))
+					continue;
+
+				if (node.leaf())
+					callback(nIndex);
+				else
+				{
+					stack.push_back(node.nLeft);
+					stack.push_back(node.nRight);
+				}
 			}
 		}
 
-		static void reset()
+		static float distance(Vector lower, Vector upper, Vector point)
 		{
-			for_each(hooks.begin(), hooks.end(), [&](Hook& hook)
-				{ hook.type = EventType::Invalid; });
+			float dx = max(max(lower.x - point.x, point.x - upper.x), 0.0f);
+			float dy = max(max(lower.y - point.y, point.y - upper.y), 0.0f);
+
+			return Geometry::length(dx, dy);
 		}
 
-		static void luaModule(Namespace flat)
+		template <typename Callback>
+		void nearest(Vector point, UINT nCount, Callback callback, UINT nMask = UINT_MAX)
 		{
-			flat.beginNamespace("engine")
-				.beginNamespace("dispatcher")
-				.addFunction<void, UINT, LuaRef>("hook", &hook)
-				.addFunction<void, UINT, LuaRef>("unhook", &unhook)
-				.addFunction<void>("reset", &reset)
-				.addConstant("update", (UINT)EventType::Update)
-				.addConstant("render", (UINT)EventType::Render)
-				.addConstant("phase", (UINT)EventType::Phase)
-				.addConstant("collision", (UINT)EventType::Collision)
-				.addConstant("keyboard", (UINT)EventType::Keyboard)
-				.addConstant("mouse", (UINT)EventType::Mouse)
-				.addConstant("network", (UINT)EventType::Network)
-				.endNamespace()
-				.endNamespace()
-				.endNamespace();
-		}
-	};
+			if (nRoot < 0 || !nCount)
+				return;
 
-	list<Event> Dispatcher::events = list<Event>();
-	list<Hook> Dispatcher::hooks = list<Hook>();
+			typedef pair<float, INT> Entry;
+			priority_queue<Entry, vector<Entry>, greater<Entry>> heap;
 
-	enum class Protocol : UINT
-	{
-		Read,
-		Write
+			heap.push(Entry(distance(nodes[nRoot].lower, nodes[nRoot].upper, point), nRoot));
+
+			while (!heap.empty() && nCount)
+			{
+				Entry entry = heap.top();
+				heap.pop();
+
+				if (entry.second < 0)
+				{
+					if (callback(-entry.second - 1))
+						nCount--;
+
+					continue;
+				}
+
+				const Node& node = nodes[entry.second];
+
+				if (!(node.nCategory & nMask))
+					continue;
+
+				if (node.leaf())
+				{
+					Vector lower, upper;
+					bounds((*node.lpTile)->transform, lower, upper);
+
+					heap.push(Entry(distance(lower, upper, point), -entry.second - 1));
+				}
+				else
+				{
+					heap.push(Entry(distance(nodes[node.nLeft].lower, nodes[node.nLeft].upper, point), node.nLeft));
+					heap.push(Entry(distance(nodes[node.nRight].lower, nodes[node.nRight].upper, point), node.nRight));
+				}
+			}
+		}
+
+		operator bool()
+		{
+			return nRoot >= 0;
+		}
 	};
 
-	class Network
+	class Grid
 	{
 	private:
-		static Server server;
-		static bool bRunning;
-		static USHORT port, clientPort;
-		static HANDLE hListener;
-		static string request, response, clientIP;
-		static bool bServed;
+		enum State : BYTE
+		{
+			Linked,
+			Overflow,
+			Skipped
+		};
 
-		static void listener()
+		struct Cells
 		{
-			server.Get("/", [](const Request& req, Response& res)
-				{
-					while (!bServed);
-					bServed = false;
-					clientIP = req.remote_addr;
-					clientPort = req.remote_port;
-					request = string();
-					Dispatcher::sendEvent(EventType::Network, new INT[]{ (INT)Protocol::Read });
-					while (!bServed);
-					res.set_content(response, "text/plain"); });
+			INT nLeft, nBottom, nRight, nTop;
+			State state;
 
-			server.Post("/", [](const Request& req, Response& res)
-				{
-					while (!bServed);
-					bServed = false;
-					clientIP = req.remote_addr;
-					clientPort = req.remote_port;
-					request = req.body;
-					Dispatcher::sendEvent(EventType::Network, new INT[]{ (INT)Protocol::Write });
-					while (!bServed);
-					res.set_content(response, "text/plain"); });
+			bool operator==(const Cells& other) const
+			{
+				return nLeft == other.nLeft && nBottom == other.nBottom && nRight == other.nRight && nTop == other.nTop && state == other.state;
+			}
+		};
 
-			server.set_read_timeout(1.0f);
-			server.set_write_timeout(1.0f);
-			server.set_keep_alive_timeout(1.0f);
+		static const float span, reach;
 
-			port = server.bind_to_any_port("127.0.0.1", 0);
+		float cellSize;
+		unordered_map<ULONGLONG, vector<UINT>> cells;
+		vector<Cells> ranges;
+		vector<UINT> overflow;
+		ULONGLONG nOccupied;
 
-			bRunning = true;
-			server.listen_after_bind();
+		static ULONGLONG key(INT x, INT y)
+		{
+			return (ULONGLONG)(UINT)x << 32 | (UINT)y;
+		}
 
-			bRunning = false;
+		Cells cover(Transform transform)
+		{
+			Vector lower, upper;
+			Tree::bounds(transform, lower, upper);
+
+			float left = floorf(lower.x / cellSize), bottom = floorf(lower.y / cellSize), right = floorf(upper.x / cellSize), top = floorf(upper.y / cellSize);
+
+			if (!(right - left < span && top - bottom < span && fabsf(left) < reach && fabsf(bottom) < reach && fabsf(right) < reach && fabsf(top) < reach))
+				return Cells{ 0, 0, -1, -1, Overflow };
+
+			return Cells{ (INT)left, (INT)bottom, (INT)right, (INT)top, Linked };
 		}
 
-		Network() {}
+		void link(UINT nIndex, Cells range)
+		{
+			if (range.state == Overflow)
+				overflow.push_back(nIndex);
+
+			for (INT x = range.nLeft; x <= range.nRight; x++)
+				for (INT y = range.nBottom; y <= range.nTop; y++)
+				{
+					vector<UINT>& cell = cells[key(x, y)];
+
+					if (cell.empty())
+						nOccupied++;
+
+					cell.push_back(nIndex);
+				}
+		}
+
+		void unlink(UINT nIndex, Cells range)
+		{
+			if (range.state == Overflow)
+				overflow.erase(remove(overflow.begin(), overflow.end(), nIndex), overflow.end());
+
+			for (INT x = range.nLeft; x <= range.nRight; x++)
+				for (INT y = range.nBottom; y <= range.nTop; y++)
+				{
+					vector<UINT>& cell = cells[key(x, y)];
+					cell.erase(remove(cell.begin(), cell.end(), nIndex), cell.end());
+
+					if (cell.empty())
+						nOccupied--;
+				}
+		}
 
 	public:
-		static USHORT start()
+		Grid(float cellSize) : cellSize(cellSize), nOccupied(0) {}
+
+		Grid() : Grid(1.0f) {}
+
+		void reset(float cellSize)
 		{
-			if (bRunning)
-				Error::raise("Failed to start network.");
-			hListener = CreateThread(nullptr, 0, (LPTHREAD_START_ROUTINE)listener, nullptr, 0, nullptr);
-			while (!bRunning)
-				;
-			bServed = true;
-			return port;
+			if (cellSize <= 0.0f)
+				Error::raise("Invalid cell size.");
+
+			if (cellSize != this->cellSize || cells.size() > nOccupied * 4 + 64)
+				cells.clear();
+			else
+				for (auto& cell : cells)
+					cell.second.clear();
+
+			this->cellSize = cellSize;
+			ranges.clear();
+			overflow.clear();
+			nOccupied = 0;
 		}
 
-		static void serve(LPCSTR res)
+		UINT insert(Transform transform, bool bLinked)
 		{
-			if (!bRunning)
-				Error::raise("Failed to serve.");
+			UINT nIndex = ranges.size();
 
-			response = res;
-			bServed = true;
+			ranges.push_back(bLinked ? cover(transform) : Cells{ 0, 0, -1, -1, Skipped });
+			link(nIndex, ranges.back());
+
+			return nIndex;
 		}
 
-		static LPCSTR read(LPCSTR ip, USHORT port)
+		void update(UINT nIndex, Transform transform)
 		{
-			Result result = Client(ip, port).Get("/");
-			if (result && result->status == StatusCode::OK_200)
-				return result->body.c_str();
-			else
-				return string().c_str();
+			if (ranges[nIndex].state == Skipped)
+				return;
+
+			Cells range = cover(transform);
+
+			if (range == ranges[nIndex])
+				return;
+
+			unlink(nIndex, ranges[nIndex]);
+			link(nIndex, range);
+
+			ranges[nIndex] = range;
 		}
 
-		static LPCSTR write(LPCSTR ip, USHORT port, LPCSTR data)
+		void query(Transform transform, vector<UINT>& candidates)
 		{
-			Result result = Client(ip, port).Post("/", data, "text/plain");
-			if (result && result->status == StatusCode::OK_200)
-				return result->body.c_str();
-			else
-				return string().c_str();
+			Cells range = cover(transform);
+
+			candidates.clear();
+
+			if (range.state == Overflow)
+				for (UINT i = 0; i < ranges.size(); i++)
+					if (ranges[i].state != Skipped)
+						candidates.push_back(i);
+
+			for (INT x = range.nLeft; x <= range.nRight; x++)
+				for (INT y = range.nBottom; y <= range.nTop; y++)
+				{
+					auto cell = cells.find(key(x, y));
+
+					if (cell != cells.end())
+						candidates.insert(candidates.end(), cell->second.begin(), cell->second.end());
+				}
+
+			candidates.insert(candidates.end(), overflow.begin(), overflow.end());
+
+			sort(candidates.begin(), candidates.end());
+			candidates.erase(unique(candidates.begin(), candidates.end()), candidates.end());
 		}
 
-		static bool running()
+		operator bool()
 		{
-			return bRunning;
+			return cellSize > 0.0f;
 		}
+	};
 
-		static void destroy()
+	const float Grid::span = 32.0f;
+	const float Grid::reach = 1e9f;
+
+	class Bodies
+	{
+	public:
+		enum Flags : BYTE
 		{
-			if (!bRunning)
-				Error::raise("Failed to destroy network");
+			Dynamic = 1,
+			Tangible = 2,
+			Pushable = 4,
+			Bullet = 8
+		};
 
-			server.stop();
-			while (bRunning)
-				;
+		vector<RefCountedPtr<Tile>*> tiles;
+		vector<INT> proxies;
+		vector<float> positionX, positionY, scaleX, scaleY, rotation;
+		vector<float> velocityX, velocityY, nextX, nextY;
+		vector<UINT> categories, masks;
+		vector<BYTE> flags, dirty;
+
+		void clear()
+		{
+			tiles.clear();
+			proxies.clear();
 		}
 
-		static void luaModule(Namespace flat)
+		void add(RefCountedPtr<Tile>* lpTile, INT nProxy)
 		{
-			flat.beginNamespace("network")
-				.addVariable("port", &port, false)
-				.addVariable("running", &bRunning, false)
-				.addVariable("request", &request, false)
-				.addVariable("response", &response, false)
-				.beginNamespace("client")
-				.addVariable("ip", &clientIP, false)
+			tiles.push_back(lpTile);
+			proxies.push_back(nProxy);
+		}
+
+		void pack()
+		{
+			UINT nCount = size();
+
+			for (vector<float>* lpArray : { &positionX, &positionY, &scaleX, &scaleY, &rotation, &velocityX, &velocityY, &nextX, &nextY })
+				lpArray->resize(nCount);
+
+			categories.resize(nCount);
+			masks.resize(nCount);
+			flags.resize(nCount);
+			dirty.assign(nCount, 0);
+
+			for (UINT i = 0; i < nCount; i++)
+			{
+				Tile& tile = ***tiles[i];
+
+				scaleX[i] = tile.transform.scale.x;
+				scaleY[i] = tile.transform.scale.y;
+				rotation[i] = tile.transform.rotation;
+				categories[i] = tile.category;
+				masks[i] = tile.mask;
+				flags[i] = (tile.dynamic ? Dynamic : 0) | (tile.tangible ? Tangible : 0) | (tile.pushable ? Pushable : 0) | (tile.bullet ? Bullet : 0);
+
+				load(i);
+			}
+		}
+
+		void load(UINT i)
+		{
+			Tile& tile = ***tiles[i];
+
+			positionX[i] = tile.transform.position.x;
+			positionY[i] = tile.transform.position.y;
+			velocityX[i] = tile.velocity.x;
+			velocityY[i] = tile.velocity.y;
+		}
+
+		void push(UINT i, Vector velocity)
+		{
+			(*tiles[i])->velocity = velocity;
+			velocityX[i] = velocity.x;
+			velocityY[i] = velocity.y;
+			dirty[i] = 1;
+		}
+
+		void integrate(Vector impulse)
+		{
+			UINT nCount = size(), i = 0;
+
+#ifdef __AVX__
+			__m256 impulseX8 = _mm256_set1_ps(impulse.x), impulseY8 = _mm256_set1_ps(impulse.y);
+
+			for (; i + 8 <= nCount; i += 8)
+			{
+				_mm256_storeu_ps(&nextX[i], _mm256_add_ps(_mm256_loadu_ps(&velocityX[i]), impulseX8));
+				_mm256_storeu_ps(&nextY[i], _mm256_add_ps(_mm256_loadu_ps(&velocityY[i]), impulseY8));
+			}
+#endif
+
+			__m128 impulseX = _mm_set1_ps(impulse.x), impulseY = _mm_set1_ps(impulse.y);
+
+			for (; i + 4 <= nCount; i += 4)
+			{
+				_mm_storeu_ps(&nextX[i], _mm_add_ps(_mm_loadu_ps(&velocityX[i]), impulseX));
+				_mm_storeu_ps(&nextY[i], _mm_add_ps(_mm_loadu_ps(&velocityY[i]), impulseY));
+			}
+
+			for (; i < nCount; i++)
+			{
+				nextX[i] = velocityX[i] + impulse.x;
+				nextY[i] = velocityY[i] + impulse.y;
+			}
+		}
+
+		Vector next(UINT i, Vector impulse)
+		{
+			if (dirty[i])
+				return (*tiles[i])->velocity + impulse;
+
+			return Vector(nextX[i], nextY[i]);
+		}
+
+		UINT overlap(Transform transform, const UINT* lpIndices, UINT nCount)
+		{
+			UINT nIndices[4];
+
+			for (UINT k = 0; k < 4; k++)
+				nIndices[k] = lpIndices[k < nCount ? k : 0];
+
+			__m128 lowerX = _mm_set_ps(positionX[nIndices[3]], positionX[nIndices[2]], positionX[nIndices[1]], positionX[nIndices[0]]);
+			__m128 lowerY = _mm_set_ps(positionY[nIndices[3]], positionY[nIndices[2]], positionY[nIndices[1]], positionY[nIndices[0]]);
+			__m128 upperX = _mm_add_ps(lowerX, _mm_set_ps(scaleX[nIndices[3]], scaleX[nIndices[2]], scaleX[nIndices[1]], scaleX[nIndices[0]]));
+			__m128 upperY = _mm_add_ps(lowerY, _mm_set_ps(scaleY[nIndices[3]], scaleY[nIndices[2]], scaleY[nIndices[1]], scaleY[nIndices[0]]));
+
+			__m128 mask = _mm_and_ps(
+				_mm_and_ps(_mm_cmpgt_ps(_mm_set1_ps(transform.position.x + transform.scale.x), lowerX), _mm_cmplt_ps(_mm_set1_ps(transform.position.x), upperX)),
+				_mm_and_ps(_mm_cmpgt_ps(_mm_set1_ps(transform.position.y + transform.scale.y), lowerY), _mm_cmplt_ps(_mm_set1_ps(transform.position.y), upperY)));
+
+			return (UINT)_mm_movemask_ps(mask) & ((1 << nCount) - 1);
+		}
+
+		Transform transform(UINT i)
+		{
+			return Transform(Vector(positionX[i], positionY[i]), Vector(scaleX[i], scaleY[i]), rotation[i]);
+		}
+
+		bool has(UINT i, Flags flag)
+		{
+			return (flags[i] & flag) != 0;
+		}
+
+		bool interacts(UINT i, UINT j)
+		{
+			return (categories[i] & masks[j]) && (categories[j] & masks[i]);
+		}
+
+		bool phase(UINT i, UINT j)
+		{
+			return !has(i, Tangible) || !has(j, Tangible) || !has(i, Dynamic) && !has(j, Dynamic);
+		}
+
+		UINT size()
+		{
+			return (UINT)tiles.size();
+		}
+
+		RefCountedPtr<Tile>& operator[](UINT i)
+		{
+			return *tiles[i];
+		}
+	};
+
+	class Text
+	{
+	public:
+		struct Glyph
+		{
+			float x, y, w, h, u1, v1, u2, v2;
+		};
+
+		struct Run
+		{
+			vector<Glyph> glyphs;
+			float width, height;
+		};
+
+	private:
+		struct Vertex
+		{
+			float x, y, u, v;
+			BYTE lpColor[4];
+		};
+
+		Text() {}
+
+		static unordered_map<string, shared_ptr<Run>> runs;
+		static vector<Vertex> vertices;
+		static GLuint glBuffer;
+		static size_t nCapacity;
+
+	public:
+		static UINT nCacheSize, nGlyphs, nLayouts;
+
+		static shared_ptr<Run> layout(const string& text)
+		{
+			shared_ptr<Run>& run = runs[text];
+
+			if (run)
+				return run;
+
+			run = make_shared<Run>();
+			run->width = 0.0f;
+			run->height = (float)_gltFontGlyphHeight;
+
+			float x = 0.0f, y = 0.0f;
+
+			for (CHAR c : text)
+			{
+				if (c == '\n' || c == '\r')
+				{
+					run->width = max(run->width, x);
+					x = 0.0f;
+
+					if (c == '\n')
+					{
+						y += (float)_gltFontGlyphHeight;
+						run->height += (float)_gltFontGlyphHeight;
+					}
+
+					continue;
+				}
+
+				if (!gltIsCharacterSupported(c))
+					continue;
+
+				_GLTglyph& glyph = _gltFontGlyphs2[c - _gltFontGlyphMinChar];
+
+				if (glyph.drawable)
+					run->glyphs.push_back(Glyph{ x, y, (float)glyph.w, (float)_gltFontGlyphHeight, glyph.u1, glyph.v1, glyph.u2, glyph.v2 });
+
+				x += (float)glyph.w;
+			}
+
+			run->width = max(run->width, x);
+			nLayouts++;
+
+			return run;
+		}
+
+		static void begin()
+		{
+			vertices.clear();
+		}
+
+		static void draw(const Run& run, Vector position, float scale, ULONG uColor)
+		{
+			BYTE lpColor[4] = { (BYTE)(uColor >> 16), (BYTE)(uColor >> 8), (BYTE)uColor, 0xFF };
+
+			for (const Glyph& glyph : run.glyphs)
+			{
+				float x1 = position.x + glyph.x * scale, y1 = position.y + glyph.y * scale;
+				float x2 = x1 + glyph.w * scale, y2 = y1 + glyph.h * scale;
+				float lpCorners[4][4] = { { x1, y1, glyph.u1, glyph.v1 }, { x1, y2, glyph.u1, glyph.v2 }, { x2, y2, glyph.u2, glyph.v2 }, { x2, y1, glyph.u2, glyph.v1 } };
+
+				for (BYTE k : { 0, 1, 2, 0, 2, 3 })
+					vertices.push_back(Vertex{ lpCorners[k][0], lpCorners[k][1], lpCorners[k][2], lpCorners[k][3], { lpColor[0], lpColor[1], lpColor[2], lpColor[3] } });
+			}
+		}
+
+		static void flush(UINT nWidth, UINT nHeight)
+		{
+			nGlyphs = (UINT)(vertices.size() / 6);
+
+			if (vertices.empty())
+				return;
+
+			if (!glBuffer)
+				glGenBuffers(1, &glBuffer);
+
+			glBindBuffer(GL_ARRAY_BUFFER, glBuffer);
+
+			if (vertices.size() > nCapacity)
+				nCapacity = vertices.size() * 2;
+
+			glBufferData(GL_ARRAY_BUFFER, nCapacity * sizeof(Vertex), nullptr, GL_STREAM_DRAW);
+			glBufferSubData(GL_ARRAY_BUFFER, 0, vertices.size() * sizeof(Vertex), vertices.data());
+
+			glLoadIdentity();
+			glOrtho(0.0, nWidth, nHeight, 0.0, -1.0, 1.0);
+
+			glEnableClientState(GL_VERTEX_ARRAY);
+			glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+			glEnableClientState(GL_COLOR_ARRAY);
+
+			glVertexPointer(2, GL_FLOAT, sizeof(Vertex), (LPVOID)offsetof(Vertex, x));
+			glTexCoordPointer(2, GL_FLOAT, sizeof(Vertex), (LPVOID)offsetof(Vertex, u));
+			glColorPointer(4, GL_UNSIGNED_BYTE, sizeof(Vertex), (LPVOID)offsetof(Vertex, lpColor));
+
+			glBindTexture(GL_TEXTURE_2D, _gltText2DFontTexture);
+			glDrawArrays(GL_TRIANGLES, 0, (GLsizei)vertices.size());
+
+			glDisableClientState(GL_COLOR_ARRAY);
+			glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+			glDisableClientState(GL_VERTEX_ARRAY);
+
+			glBindBuffer(GL_ARRAY_BUFFER, GL_NONE);
+			glColor4f(1.0f, 1.0f, 1.0f, 1.0f);
+		}
+
+		static void collect()
+		{
+			if (runs.size() <= nCacheSize)
+				return;
+
+			for (auto i = runs.begin(); i != runs.end();)
+				if (i->second.use_count() == 1)
+					i = runs.erase(i);
+				else
+					i++;
+		}
+
+		static UINT count()
+		{
+			return (UINT)runs.size();
+		}
+
+		static void destroy()
+		{
+			if (glBuffer)
+				glDeleteBuffers(1, &glBuffer);
+
+			glBuffer = GL_NONE;
+			nCapacity = 0;
+			runs.clear();
+		}
+	};
+
+	unordered_map<string, shared_ptr<Text::Run>> Text::runs = unordered_map<string, shared_ptr<Text::Run>>();
+	vector<Text::Vertex> Text::vertices = vector<Text::Vertex>();
+	GLuint Text::glBuffer = GL_NONE;
+	size_t Text::nCapacity = 0;
+	UINT Text::nCacheSize = 512;
+	UINT Text::nGlyphs = 0;
+	UINT Text::nLayouts = 0;
+
+	class Label
+	{
+	public:
+		Vector position;
+		float scale;
+		LPCSTR lpText;
+		ULONG uColor;
+		INT layer;
+		string text;
+		shared_ptr<Text::Run> run;
+
+		Label(Vector position, float scale, LPCSTR lpText, ULONG uColor) : position(position), scale(scale), lpText(lpText), uColor(uColor), layer(0) {}
+
+		Label() : Label(Vector(), 0.0f, nullptr, 0x00000000) {}
+
+		operator bool()
+		{
+			return scale && lpText;
+		}
+
+		operator LPCSTR()
+		{
+			LPSTR lpString = new CHAR[256];
+			sprintf_s(lpString, 256, "(%s, %f, %s, 0x%X)", position.operator LPCSTR(), scale, lpText, uColor);
+			return lpString;
+		}
+
+		bool operator==(Label other)
+		{
+			return position == other.position && scale == other.scale && lpText == other.lpText && uColor == other.uColor && run == other.run;
+		}
+
+		void reset()
+		{
+			text.clear();
+			run.reset();
+		}
+
+		shared_ptr<Text::Run> layout()
+		{
+			if (!run || text != lpText)
+			{
+				text = lpText;
+				run = Text::layout(text);
+			}
+
+			return run;
+		}
+
+		static void luaModule(Namespace flat)
+		{
+			flat.beginClass<Label>("label")
+				.addConstructor<void (*)(Vector, float, LPCSTR, ULONG)>()
+				.addData("position", &Label::position)
+				.addData("scale", &Label::scale)
+				.addData("text", &Label::lpText)
+				.addData("color", &Label::uColor)
+				.addData("layer", &Label::layer)
+				.addFunction<void>("reset", &reset)
+				.addFunction<bool, Label>("__eq", &operator==)
+				.addFunction<LPCSTR>("__tostring", &operator LPCSTR)
+				.endClass()
+				.endNamespace();
+		}
+	};
+
+	enum class Easing : UINT
+	{
+		Linear,
+		In,
+		Out,
+		InOut
+	};
+
+	enum class Property : UINT
+	{
+		Position,
+		Scale,
+		Rotation
+	};
+
+	class Tween
+	{
+	private:
+		vector<Vector> points;
+		vector<float> lengths;
+		float startAngle;
+		bool bStarted, bFinished;
+
+		float ease(float time)
+		{
+			switch ((Easing)easing)
+			{
+			case Easing::In:
+				return time * time;
+			case Easing::Out:
+				return time * (2.0f - time);
+			case Easing::InOut:
+				return time < 0.5f ? 2.0f * time * time : time * (4.0f - 2.0f * time) - 1.0f;
+			default:
+				return time;
+			}
+		}
+
+		Vector current()
+		{
+			switch ((Property)property)
+			{
+			case Property::Position:
+				return tile ? tile->transform.position : label->position;
+			case Property::Scale:
+				return tile ? tile->transform.scale : Vector(label->scale);
+			default:
+				return Vector(tile->transform.rotation);
+			}
+		}
+
+		void begin()
+		{
+			Vector start = current();
+
+			points.assign(1, start);
+			points.insert(points.end(), waypoints.begin(), waypoints.end());
+			points.push_back(to);
+
+			lengths.assign(1, 0.0f);
+
+			for (UINT i = 1; i < points.size(); i++)
+				lengths.push_back(lengths.back() + (points[i] - points[i - 1]).length());
+
+			startAngle = start.x;
+			bStarted = true;
+		}
+
+		Vector sample(float time)
+		{
+			float distance = lengths.back() * time;
+			UINT i = (UINT)(upper_bound(lengths.begin(), lengths.end(), distance) - lengths.begin());
+			i = min(max(i, 1u), (UINT)points.size() - 1);
+
+			float span = lengths[i] - lengths[i - 1];
+			Vector value = points[i - 1];
+			value.interpolate(points[i], span > 0.0f ? (distance - lengths[i - 1]) / span : 1.0f);
+
+			return value;
+		}
+
+		void apply(float time, float deltaTime)
+		{
+			if ((Property)property == Property::Rotation)
+			{
+				tile->transform.rotation = Geometry::interpolate(startAngle, angle, time);
+				return;
+			}
+
+			Vector value = sample(time);
+
+			if (label)
+			{
+				if ((Property)property == Property::Position)
+					label->position = value;
+				else
+					label->scale = value.x;
+
+				return;
+			}
+
+			if ((Property)property == Property::Scale)
+			{
+				tile->transform.scale = value;
+				return;
+			}
+
+			if (!tile->dynamic && deltaTime > 0.0f)
+				tile->velocity = (value - tile->transform.position) * (1.0f / deltaTime);
+
+			tile->transform.position = value;
+		}
+
+	public:
+		RefCountedPtr<Tile> tile;
+		RefCountedPtr<Label> label;
+		UINT property, easing;
+		Vector to;
+		float angle, duration, delay, elapsed;
+		bool active;
+		vector<Vector> waypoints;
+
+		Tween(UINT property, float duration) : startAngle(0.0f), bStarted(false), bFinished(false), property(property), easing((UINT)Easing::Linear), to(Vector()), angle(0.0f), duration(duration), delay(0.0f), elapsed(0.0f), active(true) {}
+
+		Tween() : Tween((UINT)Property::Position, 0.0f) {}
+
+		bool finished()
+		{
+			return bFinished;
+		}
+
+		void waypoint(Vector point)
+		{
+			waypoints.push_back(point);
+		}
+
+		void restart()
+		{
+			elapsed = 0.0f;
+			bStarted = false;
+			bFinished = false;
+		}
+
+		bool update(float deltaTime)
+		{
+			if (!active || bFinished)
+				return false;
+
+			elapsed += deltaTime;
+
+			if (elapsed < delay)
+				return false;
+
+			if (!bStarted)
+				begin();
+
+			float time = duration > 0.0f ? min((elapsed - delay) / duration, 1.0f) : 1.0f;
+			apply(ease(time), deltaTime);
+
+			if (time < 1.0f)
+				return false;
+
+			if (tile && !tile->dynamic && (Property)property == Property::Position)
+				tile->velocity = Vector();
+
+			bFinished = true;
+			return true;
+		}
+
+		operator bool()
+		{
+			return (tile || label) && !(tile && label) && property <= (UINT)Property::Rotation && easing <= (UINT)Easing::InOut && !(label && property == (UINT)Property::Rotation);
+		}
+
+		operator LPCSTR()
+		{
+			LPSTR lpString = new CHAR[256];
+			sprintf_s(lpString, 256, "(%u, %u, %f, %f)", property, easing, duration, elapsed);
+			return lpString;
+		}
+
+		static void luaModule(Namespace flat)
+		{
+			flat.beginClass<Tween>("tween")
+				.addConstructor<void (*)(UINT, float)>()
+				.addData("tile", &Tween::tile)
+				.addData("label", &Tween::label)
+				.addData("property", &Tween::property)
+				.addData("easing", &Tween::easing)
+				.addData("to", &Tween::to)
+				.addData("angle", &Tween::angle)
+				.addData("duration", &Tween::duration)
+				.addData("delay", &Tween::delay)
+				.addData("elapsed", &Tween::elapsed, false)
+				.addData("active", &Tween::active)
+				.addFunction<bool>("finished", &finished)
+				.addFunction<void, Vector>("waypoint", &waypoint)
+				.addFunction<void>("restart", &restart)
+				.addFunction<LPCSTR>("__tostring", &operator LPCSTR)
+				.endClass()
+				.endNamespace();
+		}
+	};
+
+	enum class EventType : UINT
+	{
+		Update = 1,
+		Render,
+		Phase,
+		Collision,
+		Keyboard,
+		Mouse,
+		Network,
+		Enter,
+		Stay,
+		Exit,
+		Finish,
+		Invalid
+	};
+
+	enum class Broadphase : UINT
+	{
+		Grid,
+		Tree
+	};
+
+	class Event
+	{
+	public:
+		EventType type;
+		LPVOID lpParameters;
+
+		Event(EventType type, LPVOID lpParameters) : type(type), lpParameters(lpParameters) {}
+		Event() : type(EventType::Invalid), lpParameters(nullptr) {}
+
+		operator bool()
+		{
+			return type < EventType::Invalid;
+		}
+
+		operator LPCSTR()
+		{
+			LPSTR lpString = new CHAR[256];
+			sprintf_s(lpString, 256, "(%u, %p)", type, lpParameters);
+			return lpString;
+		}
+
+		bool operator==(Event other) const
+		{
+			return type == other.type && lpParameters == other.lpParameters;
+		}
+
+		void destroy()
+		{
+			if (lpParameters)
+			{
+				delete[] lpParameters;
+				lpParameters = nullptr;
+			}
+
+			type = EventType::Invalid;
+		}
+	};
+
+	class Hook
+	{
+	public:
+		EventType type;
+		LuaRef function;
+
+		Hook(EventType type, LuaRef function) : type(type), function(function) {}
+		Hook() : type(EventType::Invalid), function(nullptr) {}
+
+		operator bool()
+		{
+			return type < EventType::Invalid;
+		}
+
+		operator LPCSTR()
+		{
+			LPSTR lpString = new CHAR[256];
+			sprintf_s(lpString, 256, "(%u, %p)", type, function.tostring());
+			return lpString;
+		}
+
+		bool operator==(Hook other) const
+		{
+			return type == other.type && function.operator==(other.function);
+		}
+	};
+
+	class Lua
+	{
+	private:
+		lua_State* L;
+
+	public:
+		Lua()
+		{
+			L = luaL_newstate();
+			luaL_openlibs(L);
+
+			lua_gc(L, LUA_GCSTOP);
+			luaL_dostring(L, "collectgarbage = nil");
+
+			getGlobalNamespace(L).beginNamespace("flat").addConstant("version", FLAT_VERSION_STRING).endNamespace();
+		}
+
+		template <typename... Args>
+		void call(LuaRef& function, Args &&...args)
+		{
+			try
+			{
+				function(args...);
+			}
+			catch (exception e)
+			{
+				Error::raise(e.what());
+			}
+		}
+
+		void loadFile(LPCSTR lpFilePath)
+		{
+			if (luaL_dofile(L, lpFilePath) != LUA_OK)
+				Error::raise(lua_tostring(L, -1));
+		}
+
+		void loadModule(void (*lpModule)(Namespace))
+		{
+			try
+			{
+				lpModule(getGlobalNamespace(L).beginNamespace("flat"));
+			}
+			catch (exception e)
+			{
+				Error::raise(e.what());
+			}
+		}
+
+		void collect()
+		{
+			lua_gc(L, LUA_GCCOLLECT);
+		}
+
+		void destroy()
+		{
+			lua_close(L);
+			L = nullptr;
+		}
+
+		operator bool()
+		{
+			return L;
+		}
+
+		bool operator==(Lua other)
+		{
+			return L == other.L;
+		}
+	};
+
+	class Console
+	{
+	private:
+		static bool bRunning;
+
+		Console() {}
+
+	public:
+		static bool running()
+		{
+			return bRunning;
+		}
+
+		static void destroy()
+		{
+			if (!bRunning || !ShowWindow(GetConsoleWindow(), SW_HIDE) || !FreeConsole())
+				Error::raise("Failed to destroy console.");
+
+			bRunning = false;
+		}
+
+		static void allocate()
+		{
+			if (bRunning)
+				Error::raise("Failed to allocate console.");
+
+			if (!AllocConsole())
+				Error::raise("Failed to allocate console.");
+
+			freopen_s((FILE**)stdin, "CONIN$", "r", stdin);
+			freopen_s((FILE**)stderr, "CONOUT$", "w", stderr);
+			freopen_s((FILE**)stdout, "CONOUT$", "w", stdout);
+
+			bRunning = true;
+		}
+
+		static void log(LPCSTR lpMessage)
+		{
+			printf("[LOG %s]: %s\n", (LPCSTR)Clock::localDate(), lpMessage);
+		}
+
+		static void print(LPCSTR lpMessage)
+		{
+			printf("%s\n", lpMessage);
+		}
+
+		static void luaModule(Namespace flat)
+		{
+			flat.beginNamespace("console")
+				.addVariable("running", &bRunning, false)
+				.addFunction<void>("allocate", &Console::allocate)
+				.addFunction<void>("destroy", &Console::destroy)
+				.addFunction<void, LPCSTR>("log", &Console::log)
+				.addFunction<void, LPCSTR>("print", &Console::print)
+				.endNamespace()
+				.endNamespace();
+		}
+	};
+
+	bool Console::bRunning = false;
+
+	class Dispatcher
+	{
+	private:
+		Dispatcher() {}
+
+		static list<Event> events;
+		static list<Hook> hooks;
+
+	public:
+		static void hook(UINT type, LuaRef function)
+		{
+			Hook hook((EventType)type, function);
+
+			if (!hook)
+				Error::raise("Invalid hook.");
+
+			hooks.push_back(hook);
+		}
+
+		static void unhook(UINT type, LuaRef function)
+		{
+			for_each(hooks.begin(), hooks.end(), [&](Hook& hook)
+				{ if (hook.type == (EventType)type && hook.function.operator==(function)) hook.type = EventType::Invalid; });
+		}
+
+		static void sendEvent(EventType type, LPVOID lpParameters)
+		{
+			Event event(type, lpParameters);
+
+			if (!event)
+				Error::raise("Invalid event.");
+
+			events.push_back(event);
+		}
+
+		static void merge(vector<Event>& buffer)
+		{
+			for (Event& event : buffer)
+			{
+				if (!event)
+					Error::raise("Invalid event.");
+
+				events.push_back(event);
+			}
+
+			buffer.clear();
+		}
+
+		static void pollEvents(Lua& lua, EventType type)
+		{
+			if (type >= EventType::Invalid)
+			{
+				hooks.remove_if([&](Hook& hook)
+					{ return !hook; });
+				events.remove_if([&](Event& event)
+					{ return !event; });
+				return;
+			}
+
+			try
+			{
+				for (Event& event : events)
+					if (event.type == type)
+					{
+						for (Hook& hook : hooks)
+							if (hook.type == type)
+								switch (type)
+								{
+								case EventType::Update:
+									lua.call(hook.function);
+									break;
+								case EventType::Render:
+									lua.call(hook.function);
+									break;
+								case EventType::Phase:
+									lua.call(hook.function, *((RefCountedPtr<Tile> **)event.lpParameters)[0], *((RefCountedPtr<Tile> **)event.lpParameters)[1]);
+									break;
+								case EventType::Collision:
+									lua.call(hook.function, *((RefCountedPtr<Tile> **)event.lpParameters)[0], *((RefCountedPtr<Tile> **)event.lpParameters)[1], *((Vector**)event.lpParameters)[2]);
+									break;
+								case EventType::Enter:
+								case EventType::Stay:
+								case EventType::Exit:
+									lua.call(hook.function, *((RefCountedPtr<Tile> **)event.lpParameters)[0], *((RefCountedPtr<Tile> **)event.lpParameters)[1]);
+									break;
+								case EventType::Keyboard:
+									lua.call(hook.function, ((UINT*)event.lpParameters)[0], ((UINT*)event.lpParameters)[1]);
+									break;
+								case EventType::Mouse:
+									lua.call(hook.function, ((UINT*)event.lpParameters)[0], ((UINT*)event.lpParameters)[1]);
+									break;
+								case EventType::Network:
+									lua.call(hook.function, ((UINT*)event.lpParameters)[0]);
+									break;
+								case EventType::Finish:
+									lua.call(hook.function, RefCountedPtr<Tween>(((Tween**)event.lpParameters)[0]));
+									break;
+								}
+
+						event.destroy();
+					}
+			}
+			catch (exception e)
+			{
+				Error::raise(e.what());
+			}
+		}
+
+		static bool hooked(EventType type)
+		{
+			for (Hook& hook : hooks)
+				if (hook.type == type)
+					return true;
+
+			return false;
+		}
+
+		static void exchange(list<Event>& other)
+		{
+			events.swap(other);
+		}
+
+		static void discard(EventType type)
+		{
+			events.remove_if([&](Event& event)
+				{
+					if (event.type != type)
+						return false;
+
+					event.destroy();
+					return true;
+				});
+		}
+
+		static void reset()
+		{
+			for_each(hooks.begin(), hooks.end(), [&](Hook& hook)
+				{ hook.type = EventType::Invalid; });
+		}
+
+		static void luaModule(Namespace flat)
+		{
+			flat.beginNamespace("engine")
+				.beginNamespace("dispatcher")
+				.addFunction<void, UINT, LuaRef>("hook", &hook)
+				.addFunction<void, UINT, LuaRef>("unhook", &unhook)
+				.addFunction<void>("reset", &reset)
+				.addConstant("update", (UINT)EventType::Update)
+				.addConstant("render", (UINT)EventType::Render)
+				.addConstant("phase", (UINT)EventType::Phase)
+				.addConstant("collision", (UINT)EventType::Collision)
+				.addConstant("keyboard", (UINT)EventType::Keyboard)
+				.addConstant("mouse", (UINT)EventType::Mouse)
+				.addConstant("network", (UINT)EventType::Network)
+				.addConstant("enter", (UINT)EventType::Enter)
+				.addConstant("stay", (UINT)EventType::Stay)
+				.addConstant("exit", (UINT)EventType::Exit)
+				.addConstant("finish", (UINT)EventType::Finish)
+				.endNamespace()
+				.endNamespace()
+				.endNamespace();
+		}
+	};
+
+	list<Event> Dispatcher::events = list<Event>();
+	list<Hook> Dispatcher::hooks = list<Hook>();
+
+	enum class Protocol : UINT
+	{
+		Read,
+		Write
+	};
+
+	class Network
+	{
+	private:
+		static Server server;
+		static bool bRunning;
+		static USHORT port, clientPort;
+		static HANDLE hListener;
+		static string request, response, clientIP;
+		static bool bServed;
+
+		static void listener()
+		{
+			server.Get("/", [](const Request& req, Response& res)
+				{
+					while (!bServed);
+					bServed = false;
+					clientIP = req.remote_addr;
+					clientPort = req.remote_port;
+					request = string();
+					Dispatcher::sendEvent(EventType::Network, new INT[]{ (INT)Protocol::Read });
+					while (!bServed);
+					res.set_content(response, "text/plain"); });
+
+			server.Post("/", [](const Request& req, Response& res)
+				{
+					while (!bServed);
+					bServed = false;
+					clientIP = req.remote_addr;
+					clientPort = req.remote_port;
+					request = req.body;
+					Dispatcher::sendEvent(EventType::Network, new INT[]{ (INT)Protocol::Write });
+					while (!bServed);
+					res.set_content(response, "text/plain"); });
+
+			server.set_read_timeout(1.0f);
+			server.set_write_timeout(1.0f);
+			server.set_keep_alive_timeout(1.0f);
+
+			port = server.bind_to_any_port("127.0.0.1", 0);
+
+			bRunning = true;
+			server.listen_after_bind();
+
+			bRunning = false;
+		}
+
+		Network() {}
+
+	public:
+		static USHORT start()
+		{
+			if (bRunning)
+				Error::raise("Failed to start network.");
+			hListener = CreateThread(nullptr, 0, (LPTHREAD_START_ROUTINE)listener, nullptr, 0, nullptr);
+			while (!bRunning)
+				;
+			bServed = true;
+			return port;
+		}
+
+		static void serve(LPCSTR res)
+		{
+			if (!bRunning)
+				Error::raise("Failed to serve.");
+
+			response = res;
+			bServed = true;
+		}
+
+		static LPCSTR read(LPCSTR ip, USHORT port)
+		{
+			Result result = Client(ip, port).Get("/");
+			if (result && result->status == StatusCode::OK_200)
+				return result->body.c_str();
+			else
+				return string().c_str();
+		}
+
+		static LPCSTR write(LPCSTR ip, USHORT port, LPCSTR data)
+		{
+			Result result = Client(ip, port).Post("/", data, "text/plain");
+			if (result && result->status == StatusCode::OK_200)
+				return result->body.c_str();
+			else
+				return string().c_str();
+		}
+
+		static bool running()
+		{
+			return bRunning;
+		}
+
+		static void destroy()
+		{
+			if (!bRunning)
+				Error::raise("Failed to destroy network");
+
+			server.stop();
+			while (bRunning)
+				;
+		}
+
+		static void luaModule(Namespace flat)
+		{
+			flat.beginNamespace("network")
+				.addVariable("port", &port, false)
+				.addVariable("running", &bRunning, false)
+				.addVariable("request", &request, false)
+				.addVariable("response", &response, false)
+				.beginNamespace("client")
+				.addVariable("ip", &clientIP, false)
 				.addVariable("port", &clientPort, false)
 				.endNamespace()
 				.addFunction<USHORT>("start", &Network::start)
@@ -1521,22 +3337,2870 @@ namespace Flat
 				.endNamespace()
 				.endNamespace();
 		}
-	};
+	};
+
+	bool Network::bRunning = false;
+	Server Network::server = Server();
+	USHORT Network::port = 0;
+	USHORT Network::clientPort = 0;
+	HANDLE Network::hListener = nullptr;
+	string Network::request = string();
+	string Network::response = string();
+	string Network::clientIP = string();
+	bool Network::bServed = false;
+
+	void exit()
+	{
+		ExitProcess(0);
+	}
+
+	class Pool
+	{
+	private:
+		struct Worker
+		{
+			deque<function<void()>> tasks;
+			mutex lock;
+		};
+
+		vector<thread> threads;
+		vector<unique_ptr<Worker>> workers;
+		mutex lock;
+		condition_variable wakeup, finished;
+		atomic<UINT> nPending;
+		ULONGLONG nGeneration;
+		bool bStopping;
+
+		bool take(UINT nWorker, function<void()>& task)
+		{
+			{
+				Worker& worker = *workers[nWorker];
+				lock_guard<mutex> guard(worker.lock);
+
+				if (!worker.tasks.empty())
+				{
+					task = move(worker.tasks.back());
+					worker.tasks.pop_back();
+					return true;
+				}
+			}
+
+			for (UINT i = 1; i < workers.size(); i++)
+			{
+				Worker& victim = *workers[(nWorker + i) % workers.size()];
+				lock_guard<mutex> guard(victim.lock);
+
+				if (!victim.tasks.empty())
+				{
+					task = move(victim.tasks.front());
+					victim.tasks.pop_front();
+					return true;
+				}
+			}
+
+			return false;
+		}
+
+		void drain(UINT nWorker)
+		{
+			function<void()> task;
+
+			while (nPending && take(nWorker, task))
+			{
+				task();
+
+				if (--nPending == 0)
+				{
+					lock_guard<mutex> guard(lock);
+					finished.notify_all();
+				}
+			}
+		}
+
+		void work(UINT nWorker)
+		{
+			ULONGLONG nSeen = 0;
+
+			while (true)
+			{
+				{
+					unique_lock<mutex> guard(lock);
+					wakeup.wait(guard, [&]()
+						{ return bStopping || nGeneration != nSeen; });
+
+					if (bStopping)
+						return;
+
+					nSeen = nGeneration;
+				}
+
+				drain(nWorker);
+			}
+		}
+
+	public:
+		Pool() : nPending(0), nGeneration(0), bStopping(false) {}
+
+		Pool(const Pool&) = delete;
+
+		~Pool()
+		{
+			resize(0);
+		}
+
+		UINT size()
+		{
+			return workers.size();
+		}
+
+		void resize(UINT nThreads)
+		{
+			if (nThreads == size())
+				return;
+
+			{
+				lock_guard<mutex> guard(lock);
+				bStopping = true;
+				wakeup.notify_all();
+			}
+
+			for (thread& worker : threads)
+				worker.join();
+
+			threads.clear();
+			workers.clear();
+			bStopping = false;
+
+			if (!nThreads)
+				return;
+
+			for (UINT i = 0; i < nThreads; i++)
+				workers.push_back(make_unique<Worker>());
+
+			for (UINT i = 1; i < nThreads; i++)
+				threads.push_back(thread(&Pool::work, this, i));
+		}
+
+		void run(vector<function<void()>>& tasks)
+		{
+			if (workers.empty())
+				resize(1);
+
+			for (UINT i = 0; i < tasks.size(); i++)
+			{
+				Worker& worker = *workers[i % workers.size()];
+				lock_guard<mutex> guard(worker.lock);
+				worker.tasks.push_back(move(tasks[i]));
+			}
+
+			nPending = tasks.size();
+
+			{
+				lock_guard<mutex> guard(lock);
+				nGeneration++;
+				wakeup.notify_all();
+			}
+
+			drain(0);
+
+			unique_lock<mutex> guard(lock);
+			finished.wait(guard, [&]()
+				{ return nPending == 0; });
+		}
+
+		operator bool()
+		{
+			return !workers.empty();
+		}
+	};
+
+	class Physics
+	{
+	private:
+		Physics() {}
+
+		static float deltaTime;
+		static Grid grid;
+		static Tree tree;
+		static unordered_map<RefCountedPtr<Tile>*, INT> proxies;
+		static Bodies bodies;
+
+		typedef pair<RefCountedPtr<Tile>*, RefCountedPtr<Tile>*> Pair;
+
+		struct PairHash
+		{
+			size_t operator()(const Pair& pair) const
+			{
+				return hash<LPVOID>()(pair.first) * 31 ^ hash<LPVOID>()(pair.second);
+			}
+		};
+
+		struct Contact
+		{
+			RefCountedPtr<Tile>* lpTile;
+			RefCountedPtr<Tile>* lpOther;
+			ULONGLONG nStep;
+		};
+
+		struct Touch
+		{
+			Pair pair;
+			Vector normal;
+		};
+
+		struct Manifold
+		{
+			RefCountedPtr<Tile>* lpTile;
+			RefCountedPtr<Tile>* lpOther;
+			Vector normal;
+			float normalImpulse, tangentImpulse;
+			UINT nIndex, nOther;
+			bool bSolved;
+		};
+
+		struct Strip
+		{
+			vector<UINT> bodies, deferred, wakes, candidates;
+			vector<Event> events;
+			vector<Pair> contacts;
+			vector<Touch> touches;
+			deque<Vector> impulses;
+			ULONGLONG nTests;
+		};
+
+		static Pool pool;
+		static bool bParallel;
+		static vector<Transform> reaches;
+		static vector<Strip> strips;
+		static vector<UINT> deferred;
+		static Strip serial;
+		static unordered_map<Pair, Contact, PairHash> contacts;
+		static ULONGLONG nStep;
+		static bool bReportPhase, bReportCollision, bReportEnter, bReportStay, bReportExit;
+		static vector<RefCountedPtr<Tile>*> ordered;
+		static unordered_map<Pair, Manifold, PairHash> manifolds;
+		static vector<BYTE> supported, visited;
+		static vector<UINT> owners;
+		static vector<pair<UINT, UINT>> precedence;
+
+		struct Block
+		{
+			RefCountedPtr<Tile> tile;
+			vector<RefCountedPtr<Tile>*> tiles;
+			INT nProxy;
+		};
+
+		struct Member
+		{
+			list<Block>::iterator block;
+			Transform transform;
+			UINT nCategory, nMask;
+		};
+
+		static list<Block> blocks;
+		static unordered_map<RefCountedPtr<Tile>*, list<Block>::iterator> merged;
+		static unordered_map<RefCountedPtr<Tile>*, Member> members;
+		static vector<RefCountedPtr<Tile>*> unmerged;
+
+		struct State
+		{
+			Grid grid;
+			Tree tree;
+			unordered_map<RefCountedPtr<Tile>*, INT> proxies;
+			unordered_map<Pair, Contact, PairHash> contacts;
+			unordered_map<Pair, Manifold, PairHash> manifolds;
+			list<Block> blocks;
+			unordered_map<RefCountedPtr<Tile>*, list<Block>::iterator> merged;
+			unordered_map<RefCountedPtr<Tile>*, Member> members;
+			vector<RefCountedPtr<Tile>*> unmerged;
+			ULONGLONG nStep, stateHash, nTests;
+		};
+
+		static void exchange(State& state)
+		{
+			swap(grid, state.grid);
+			swap(tree, state.tree);
+			swap(proxies, state.proxies);
+			swap(contacts, state.contacts);
+			swap(manifolds, state.manifolds);
+			swap(blocks, state.blocks);
+			swap(merged, state.merged);
+			swap(members, state.members);
+			swap(unmerged, state.unmerged);
+			swap(nStep, state.nStep);
+			swap(stateHash, state.stateHash);
+			swap(nTests, state.nTests);
+		}
+
+		static Transform sweep(Transform transform, Vector movement)
+		{
+			Transform swept = transform.rotation ? box(transform) : transform;
+
+			swept.position -= Vector(max(movement.x, 0.0f), max(movement.y, 0.0f));
+			swept.scale += Vector(fabsf(movement.x), fabsf(movement.y));
+
+			return swept;
+		}
+
+		static Transform box(Transform transform)
+		{
+			Vector lower, upper;
+			Tree::bounds(transform, lower, upper);
+
+			return Transform(lower, upper - lower, 0.0f);
+		}
+
+		static bool touch(Transform a, Transform b)
+		{
+			return a.position.x <= b.position.x + b.scale.x && b.position.x <= a.position.x + a.scale.x && a.position.y <= b.position.y + b.scale.y && b.position.y <= a.position.y + a.scale.y;
+		}
+
+		static bool inside(Transform inner, Transform outer)
+		{
+			return inner.position.x >= outer.position.x && inner.position.y >= outer.position.y && inner.position.x + inner.scale.x <= outer.position.x + outer.scale.x && inner.position.y + inner.scale.y <= outer.position.y + outer.scale.y;
+		}
+
+		static bool linked(UINT i)
+		{
+			return bodies.has(i, Bodies::Tangible) || bReportPhase || bReportEnter || bReportStay || bReportExit;
+		}
+
+		static void gather(Transform swept, vector<UINT>& candidates, UINT nMask = UINT_MAX)
+		{
+			if (broadphase == (UINT)Broadphase::Grid || bParallel)
+			{
+				grid.query(swept, candidates);
+				return;
+			}
+
+			Vector lower, upper;
+			Tree::bounds(swept, lower, upper);
+
+			candidates.clear();
+
+			tree.query(lower, upper, [&](INT nProxy)
+				{ if (tree.order(nProxy) < bodies.size() && linked(tree.order(nProxy))) candidates.push_back(tree.order(nProxy)); }, nMask);
+
+			sort(candidates.begin(), candidates.end());
+		}
+
+		static void gather(UINT nIndex, Transform swept, Strip& strip)
+		{
+			vector<UINT>& candidates = strip.candidates;
+			gather(swept, candidates, bodies.masks[nIndex]);
+
+			candidates.erase(remove_if(candidates.begin(), candidates.end(), [&](UINT j)
+				{ return !bodies.interacts(nIndex, j) || bParallel && !touch(reaches[nIndex], reaches[j]); }), candidates.end());
+
+			strip.nTests += candidates.size();
+		}
+
+		static float& axis(Vector& vector, bool bVertical)
+		{
+			return bVertical ? vector.y : vector.x;
+		}
+
+		static void wake(UINT nIndex)
+		{
+			vector<UINT> stack(1, nIndex), neighbours;
+
+			bodies[nIndex]->wake();
+
+			while (!stack.empty())
+			{
+				UINT i = stack.back();
+				RefCountedPtr<Tile>& tile = bodies[i];
+				stack.pop_back();
+
+				tile->bSlept = false;
+
+				Transform reach = tile->transform;
+				reach.position -= Vector(Tile::sleepMargin);
+				reach.scale += Vector(Tile::sleepMargin * 2.0f);
+
+				gather(reach, neighbours, bodies.masks[i]);
+
+				for (UINT j : neighbours)
+				{
+					RefCountedPtr<Tile>& tile2 = bodies[j];
+
+					if (tile2->dynamic && tile2->sleeping && bodies.interacts(i, j) && Transform::intersect(reach, tile2->transform))
+					{
+						tile2->wake();
+						stack.push_back(j);
+					}
+				}
+			}
+		}
+
+		static bool solved(RefCountedPtr<Tile>* lpTile, RefCountedPtr<Tile>* lpOther)
+		{
+			if (manifolds.empty())
+				return false;
+
+			auto found = manifolds.find(lpTile < lpOther ? Pair(lpTile, lpOther) : Pair(lpOther, lpTile));
+
+			return found != manifolds.end() && found->second.bSolved;
+		}
+
+		static bool respond(UINT nIndex, UINT j, Vector normal, Strip& strip)
+		{
+			RefCountedPtr<Tile>& tile = bodies[nIndex];
+			RefCountedPtr<Tile>& tile2 = bodies[j];
+
+			if (tile2->sleeping && (tile->velocity - tile2->velocity).length() > Tile::sleepVelocity)
+			{
+				if (bParallel)
+					strip.wakes.push_back(j);
+				else
+					wake(j);
+			}
+
+			Vector impulse = normal * (Vector::dot(tile->velocity + tile2->velocity, normal) * 0.5f);
+
+			RefCountedPtr<Tile>& other = resolve(j, tile->transform);
+
+			strip.contacts.push_back(Pair(&tile, &other));
+			strip.touches.push_back(Touch{ Pair(&tile, &other), normal });
+
+			if (bReportCollision)
+			{
+				strip.impulses.push_back(impulse);
+				strip.events.push_back(Event(EventType::Collision, new LPVOID[]{ &tile, &other, &strip.impulses.back() }));
+			}
+
+			if (solved(&tile, &other))
+			{
+				bodies.load(nIndex);
+				return true;
+			}
+
+			if (bodies.has(j, Bodies::Pushable))
+				bodies.push(j, tile2->velocity - normal * Vector::dot(tile2->velocity, normal) + impulse);
+
+			Vector normalVelocity = normal * Vector::dot(tile->velocity, normal);
+			Vector tangentVelocity = tile->velocity - normalVelocity;
+
+			tile->velocity = tangentVelocity - tangentVelocity * tile->friction - normalVelocity * tile->bounciness;
+
+			bodies.load(nIndex);
+			return false;
+		}
+
+		static float impact(UINT nIndex, bool bVertical, float movement, Strip& strip, bool& bCollided)
+		{
+			RefCountedPtr<Tile>& tile = bodies[nIndex];
+			vector<UINT>& candidates = strip.candidates;
+
+			Vector sweepMovement;
+			axis(sweepMovement, bVertical) = movement;
+
+			Transform transform = tile->transform;
+			gather(nIndex, sweep(transform, -sweepMovement), strip);
+
+			float lower = axis(transform.position, bVertical), upper = lower + axis(transform.scale, bVertical);
+			float crossLower = axis(transform.position, !bVertical), crossUpper = crossLower + axis(transform.scale, !bVertical);
+			float distance = movement;
+			UINT nHit = UINT_MAX;
+
+			for (UINT j : candidates)
+			{
+				Transform transform2 = bodies.transform(j);
+
+				if (j == nIndex || bodies.phase(nIndex, j) || Transform::intersect(transform, transform2))
+					continue;
+
+				float crossLower2 = axis(transform2.position, !bVertical);
+
+				if (crossUpper <= crossLower2 || crossLower >= crossLower2 + axis(transform2.scale, !bVertical))
+					continue;
+
+				float lower2 = axis(transform2.position, bVertical);
+				float entry = movement > 0.0f ? lower2 - upper : lower2 + axis(transform2.scale, bVertical) - lower;
+
+				if (movement > 0.0f ? entry >= 0.0f && entry < distance : entry <= 0.0f && entry > distance)
+				{
+					distance = entry;
+					nHit = j;
+				}
+			}
+
+			if (nHit != UINT_MAX)
+			{
+				Vector normal;
+				axis(normal, bVertical) = movement > 0.0f ? -1.0f : 1.0f;
+
+				bCollided = true;
+				respond(nIndex, nHit, normal, strip);
+			}
+
+			return distance;
+		}
+
+		static void collide(UINT nIndex, bool bVertical, float movement, Strip& strip, bool& bCollided, bool& bPhased)
+		{
+			RefCountedPtr<Tile>& tile = bodies[nIndex];
+			vector<UINT>& candidates = strip.candidates;
+
+			Vector sweepMovement;
+			axis(sweepMovement, bVertical) = movement;
+
+			Transform swept = sweep(tile->transform, sweepMovement);
+			gather(nIndex, swept, strip);
+
+			bodies.load(nIndex);
+
+			UINT nBatch = UINT_MAX, nMask = 0;
+
+			for (UINT k = 0; k < candidates.size(); k++)
+			{
+				if (nBatch == UINT_MAX || k - nBatch >= 4)
+				{
+					nBatch = k;
+					nMask = bodies.overlap(tile->transform, &candidates[k], min((UINT)candidates.size() - k, 4u));
+				}
+
+				UINT j = candidates[k];
+				RefCountedPtr<Tile>& tile2 = bodies[j];
+
+				Transform transform2 = bodies.transform(j);
+				bool bOriented = tile->transform.rotation || transform2.rotation;
+				Vector translation;
+
+				if (bOriented ? !Transform::intersect(box(tile->transform), box(transform2)) : !(nMask >> (k - nBatch) & 1))
+					continue;
+
+				if (tile->transform == transform2 || bOriented && !Transform::separate(tile->transform, transform2, translation))
+					continue;
+
+				if (bodies.phase(nIndex, j))
+				{
+					RefCountedPtr<Tile>& other = resolve(j, tile->transform);
+
+					strip.contacts.push_back(Pair(&tile, &other));
+
+					if (bReportPhase)
+						strip.events.push_back(Event(EventType::Phase, new LPVOID[]{ &tile, &other }));
+
+					bPhased = true;
+					continue;
+				}
+
+				bCollided = true;
+
+				Vector normal;
+
+				if (bOriented)
+				{
+					tile->transform.position += translation;
+					normal = translation.unit();
+				}
+				else
+				{
+					Vector center = tile->transform.center(), center2 = transform2.center();
+
+					axis(tile->transform.position, bVertical) -= movement;
+					axis(normal, bVertical) = movement > 0.0f || !movement && axis(center, bVertical) < axis(center2, bVertical) ? -1.0f : 1.0f;
+				}
+
+				if (respond(nIndex, j, normal, strip) && !bOriented)
+				{
+					float start = axis(tile->transform.position, bVertical);
+					float contact = movement > 0.0f ? axis(transform2.position, bVertical) - axis(tile->transform.scale, bVertical) : axis(transform2.position, bVertical) + axis(transform2.scale, bVertical);
+
+					if (movement > 0.0f ? contact > start : contact < start)
+					{
+						axis(tile->transform.position, bVertical) = contact;
+						bodies.load(nIndex);
+					}
+				}
+
+				nBatch = UINT_MAX;
+
+				if (!inside(box(tile->transform), box(swept)))
+				{
+					swept = sweep(tile->transform, -sweepMovement);
+					gather(nIndex, swept, strip);
+					k = upper_bound(candidates.begin(), candidates.end(), j) - candidates.begin() - 1;
+				}
+			}
+		}
+
+		static bool step(UINT nIndex, Strip& strip)
+		{
+			RefCountedPtr<Tile>& tile = bodies[nIndex];
+
+			if (!bodies.has(nIndex, Bodies::Dynamic))
+				return true;
+
+			if (tile->bSlept && tile->disturbed())
+			{
+				if (bParallel)
+					return false;
+
+				wake(nIndex);
+			}
+
+			if (tile->sleeping)
+				return true;
+
+			Vector velocity = bodies.next(nIndex, gravity * deltaTime);
+			Vector movement = velocity * deltaTime;
+
+			if (bParallel && !inside(sweep(sweep(box(tile->transform), movement), -movement), reaches[nIndex]))
+				return false;
+
+			tile->velocity = velocity;
+
+			bool bCollided = false, bPhased = false;
+
+			if (bodies.has(nIndex, Bodies::Bullet))
+				movement.x = impact(nIndex, false, movement.x, strip, bCollided);
+
+			tile->transform.position.x += movement.x;
+			collide(nIndex, false, movement.x, strip, bCollided, bPhased);
+
+			if (bodies.has(nIndex, Bodies::Bullet))
+				movement.y = impact(nIndex, true, movement.y, strip, bCollided);
+
+			tile->transform.position.y += movement.y;
+			collide(nIndex, true, movement.y, strip, bCollided, bPhased);
+
+			if (bDeterministic)
+			{
+				settle(**tile);
+				bodies.load(nIndex);
+			}
+
+			if (tile->velocity.length() < Tile::sleepVelocity && (bCollided || supported[nIndex] || !gravity) && !bPhased)
+				tile->rest += deltaTime;
+			else
+				tile->rest = 0.0f;
+
+			if (tile->rest >= Tile::sleepTime)
+				tile->sleep();
+
+			bodies.load(nIndex);
+
+			if (bParallel)
+				return true;
+
+			if (broadphase == (UINT)Broadphase::Grid)
+				grid.update(nIndex, tile->transform);
+
+			tree.move(bodies.proxies[nIndex]);
+
+			return true;
+		}
+
+		static void partition()
+		{
+			reaches.resize(bodies.size());
+
+			float left = Math::infinity, right = -Math::infinity;
+
+			for (UINT i = 0; i < bodies.size(); i++)
+			{
+				RefCountedPtr<Tile>& tile = bodies[i];
+
+				reaches[i] = box(tile->transform);
+
+				if (!bodies.has(i, Bodies::Dynamic) || tile->sleeping)
+					continue;
+
+				Vector movement = bodies.next(i, gravity * deltaTime) * deltaTime;
+				Vector margin = Vector(fabsf(movement.x), fabsf(movement.y)) * 2.0f + Vector(Tile::sleepMargin);
+
+				reaches[i].position -= margin;
+				reaches[i].scale += margin * 2.0f;
+
+				left = min(left, reaches[i].center().x);
+				right = max(right, reaches[i].center().x);
+			}
+
+			float width = max((right - left) / (nThreads * 4), cellSize * 4.0f);
+			UINT nStrips = right >= left ? (UINT)((right - left) / width) + 1 : 0;
+
+			strips.resize(max(nStrips, (UINT)strips.size()));
+
+			for (Strip& strip : strips)
+			{
+				strip.bodies.clear();
+				strip.deferred.clear();
+				strip.wakes.clear();
+				strip.contacts.clear();
+				strip.touches.clear();
+				strip.impulses.clear();
+				strip.nTests = 0;
+			}
+
+			grid.reset(cellSize);
+
+			for (UINT i = 0; i < reaches.size(); i++)
+				grid.insert(reaches[i], linked(i));
+
+			deferred.clear();
+			owners.assign(bodies.size(), UINT_MAX);
+
+			vector<UINT> candidates;
+
+			for (UINT i = 0; i < bodies.size(); i++)
+			{
+				RefCountedPtr<Tile>& tile = bodies[i];
+
+				if (!bodies.has(i, Bodies::Dynamic) || tile->sleeping && !(tile->bSlept && tile->disturbed()))
+					continue;
+
+				UINT nStrip = (UINT)((reaches[i].center().x - left) / width);
+				Transform zone(Vector(left + width * (nStrip - 0.25f), -Math::infinity), Vector(width * 1.5f, Math::infinity), 0.0f);
+
+				bool bInterior = !tile->sleeping && reaches[i].position.x >= zone.position.x && reaches[i].position.x + reaches[i].scale.x <= zone.position.x + zone.scale.x;
+
+				if (bInterior)
+				{
+					grid.query(reaches[i], candidates);
+
+					for (UINT j : candidates)
+					{
+						RefCountedPtr<Tile>& tile2 = bodies[j];
+
+						if (bodies.has(j, (Bodies::Flags)(Bodies::Dynamic | Bodies::Pushable)) && touch(reaches[i], reaches[j]) && (reaches[j].position.x < zone.position.x || reaches[j].position.x + reaches[j].scale.x > zone.position.x + zone.scale.x))
+						{
+							bInterior = false;
+							break;
+						}
+					}
+				}
+
+				if (bInterior)
+				{
+					strips[nStrip].bodies.push_back(i);
+					owners[i] = nStrip;
+				}
+				else
+					deferred.push_back(i);
+			}
+		}
+
+		static bool mergeable(Tile& tile)
+		{
+			return !tile.dynamic && tile.tangible && !tile.pushable && !tile.bullet && !tile.transform.rotation && tile.velocity == Vector() && tile;
+		}
+
+		static void dissolve(list<Block>::iterator block)
+		{
+			tree.remove(block->nProxy);
+			merged.erase(&block->tile);
+
+			for (RefCountedPtr<Tile>* lpTile : block->tiles)
+			{
+				members.erase(lpTile);
+				unmerged.push_back(lpTile);
+			}
+
+			blocks.erase(block);
+		}
+
+		static void separate(RefCountedPtr<Tile>* lpTile)
+		{
+			list<Block>::iterator block = members[lpTile].block;
+
+			if (block != blocks.end())
+			{
+				dissolve(block);
+				return;
+			}
+
+			members.erase(lpTile);
+			unmerged.push_back(lpTile);
+		}
+
+		static void merge()
+		{
+			if (unmerged.empty())
+				return;
+
+			vector<RefCountedPtr<Tile>*> touched;
+
+			for (RefCountedPtr<Tile>* lpTile : unmerged)
+			{
+				Transform region = box((*lpTile)->transform);
+
+				tree.query(region.position, region.position + region.scale, [&](INT nProxy)
+					{
+						RefCountedPtr<Tile>* lpOther = tree.tile(nProxy);
+
+						if ((merged.count(lpOther) || members.count(lpOther)) && (*lpOther)->category == (*lpTile)->category && (*lpOther)->mask == (*lpTile)->mask && touch(box((*lpOther)->transform), region))
+							touched.push_back(lpOther);
+					}, (*lpTile)->category);
+			}
+
+			sort(touched.begin(), touched.end());
+			touched.erase(unique(touched.begin(), touched.end()), touched.end());
+
+			for (RefCountedPtr<Tile>* lpOther : touched)
+				if (merged.count(lpOther))
+					dissolve(merged[lpOther]);
+				else if (members.count(lpOther))
+					separate(lpOther);
+
+			sort(unmerged.begin(), unmerged.end());
+			unmerged.erase(unique(unmerged.begin(), unmerged.end()), unmerged.end());
+
+			struct Run
+			{
+				Vector lower, upper;
+				vector<RefCountedPtr<Tile>*> tiles;
+				UINT nCategory, nMask;
+				ULONGLONG id;
+			};
+
+			vector<Run> runs;
+
+			for (RefCountedPtr<Tile>* lpTile : unmerged)
+			{
+				Tile& tile = ***lpTile;
+
+				if (!mergeable(tile))
+					continue;
+
+				Run run{ Vector(), Vector(), vector<RefCountedPtr<Tile>*>(1, lpTile), tile.category, tile.mask, tile.id };
+				Tree::bounds(tile.transform, run.lower, run.upper);
+				runs.push_back(run);
+			}
+
+			unmerged.clear();
+
+			for (bool bVertical : { false, true })
+			{
+				sort(runs.begin(), runs.end(), [&](const Run& a, const Run& b)
+					{
+						float a1 = bVertical ? a.lower.x : a.lower.y, a2 = bVertical ? a.upper.x : a.upper.y, a3 = bVertical ? a.lower.y : a.lower.x;
+						float b1 = bVertical ? b.lower.x : b.lower.y, b2 = bVertical ? b.upper.x : b.upper.y, b3 = bVertical ? b.lower.y : b.lower.x;
+
+						return make_tuple(a.nCategory, a.nMask, a1, a2, a3, a.id) < make_tuple(b.nCategory, b.nMask, b1, b2, b3, b.id);
+					});
+
+				vector<Run> joined;
+
+				for (Run& run : runs)
+				{
+					Run* lpLast = joined.empty() ? nullptr : &joined.back();
+
+					if (lpLast && lpLast->nCategory == run.nCategory && lpLast->nMask == run.nMask && axis(lpLast->lower, !bVertical) == axis(run.lower, !bVertical) && axis(lpLast->upper, !bVertical) == axis(run.upper, !bVertical) && axis(run.lower, bVertical) <= axis(lpLast->upper, bVertical))
+					{
+						axis(lpLast->upper, bVertical) = max(axis(lpLast->upper, bVertical), axis(run.upper, bVertical));
+						lpLast->tiles.insert(lpLast->tiles.end(), run.tiles.begin(), run.tiles.end());
+					}
+					else
+						joined.push_back(run);
+				}
+
+				runs.swap(joined);
+			}
+
+			for (Run& run : runs)
+			{
+				if (run.tiles.size() == 1)
+				{
+					RefCountedPtr<Tile>* lpTile = run.tiles.front();
+					members[lpTile] = Member{ blocks.end(), (*lpTile)->transform, run.nCategory, run.nMask };
+					continue;
+				}
+
+				Tile& first = ***run.tiles.front();
+
+				blocks.push_back(Block{ RefCountedPtr<Tile>(new Tile(Transform(run.lower, run.upper - run.lower, 0.0f), first.texture, false, true, false, first.bounciness, first.friction, Vector())), run.tiles, 0 });
+
+				list<Block>::iterator block = prev(blocks.end());
+				block->tile->category = run.nCategory;
+				block->tile->mask = run.nMask;
+				block->nProxy = tree.insert(&block->tile);
+				merged[&block->tile] = block;
+
+				for (RefCountedPtr<Tile>* lpTile : run.tiles)
+					members[lpTile] = Member{ block, (*lpTile)->transform, (*lpTile)->category, (*lpTile)->mask };
+			}
+		}
+
+		static RefCountedPtr<Tile>& resolve(UINT j, Transform transform)
+		{
+			RefCountedPtr<Tile>& tile = bodies[j];
+			auto block = merged.find(&tile);
+
+			if (block == merged.end())
+				return tile;
+
+			Vector lower, upper;
+			Tree::bounds(transform, lower, upper);
+
+			RefCountedPtr<Tile>* lpNearest = block->second->tiles.front();
+			float nearest = Math::infinity;
+
+			tree.query(lower - Vector(Tile::sleepMargin), upper + Vector(Tile::sleepMargin), [&](INT nProxy)
+				{
+					RefCountedPtr<Tile>* lpTile = tree.tile(nProxy);
+					auto member = members.find(lpTile);
+
+					if (member == members.end() || member->second.block != block->second)
+						return;
+
+					Vector tileLower, tileUpper;
+					Tree::bounds((*lpTile)->transform, tileLower, tileUpper);
+
+					float distance = Tree::distance(tileLower, tileUpper, transform.center());
+
+					if (distance < nearest || distance == nearest && (*lpTile)->id < (*lpNearest)->id)
+					{
+						nearest = distance;
+						lpNearest = lpTile;
+					}
+				}, tile->category);
+
+			return *lpNearest;
+		}
+
+		static void settle(Tile& tile)
+		{
+			const float step = 1.0f / 65536.0f;
+
+			tile.transform.position = Vector(Math::quantize(tile.transform.position.x, step), Math::quantize(tile.transform.position.y, step));
+			tile.velocity = Vector(Math::quantize(tile.velocity.x, step), Math::quantize(tile.velocity.y, step));
+		}
+
+		static ULONGLONG digest()
+		{
+			ULONGLONG hash = 14695981039346656037ULL;
+
+			auto mix = [&](LPCVOID lpData, size_t nSize)
+				{
+					for (size_t i = 0; i < nSize; i++)
+					{
+						hash ^= ((const BYTE*)lpData)[i];
+						hash *= 1099511628211ULL;
+					}
+				};
+
+			for (UINT i = 0; i < bodies.size(); i++)
+			{
+				Tile& tile = **bodies[i];
+				BYTE nState = tile.sleeping;
+
+				mix(&tile.id, sizeof(tile.id));
+				mix(&tile.transform.position, sizeof(Vector));
+				mix(&tile.transform.scale, sizeof(Vector));
+				mix(&tile.transform.rotation, sizeof(float));
+				mix(&tile.velocity, sizeof(Vector));
+				mix(&nState, sizeof(nState));
+			}
+
+			return hash;
+		}
+
+		static pair<ULONGLONG, ULONGLONG> rank(Manifold& manifold)
+		{
+			ULONGLONG nId = (*manifold.lpTile)->id, nOtherId = (*manifold.lpOther)->id;
+			return nId < nOtherId ? make_pair(nId, nOtherId) : make_pair(nOtherId, nId);
+		}
+
+		static void refresh(vector<Touch>& touches)
+		{
+			if (!nIterations)
+				return;
+
+			for (Touch& touch : touches)
+			{
+				Pair key = touch.pair.first < touch.pair.second ? touch.pair : Pair(touch.pair.second, touch.pair.first);
+				auto found = manifolds.find(key);
+
+				if (found == manifolds.end())
+				{
+					manifolds[key] = Manifold{ touch.pair.first, touch.pair.second, touch.normal, 0.0f, 0.0f, UINT_MAX, UINT_MAX, false };
+					continue;
+				}
+
+				Manifold& manifold = found->second;
+
+				if (manifold.lpTile != touch.pair.first)
+					swap(manifold.nIndex, manifold.nOther);
+
+				manifold.lpTile = touch.pair.first;
+				manifold.lpOther = touch.pair.second;
+				manifold.normal = touch.normal;
+			}
+		}
+
+		template <class Locate> static void discover(Locate& locate)
+		{
+			vector<UINT> pending;
+			vector<BYTE> discovered(bodies.size(), 0);
+
+			auto pushes = [&](UINT i)
+				{ return i != UINT_MAX && !discovered[i] && bodies.has(i, (Bodies::Flags)(Bodies::Dynamic | Bodies::Pushable)) && !bodies[i]->sleeping; };
+
+			vector<Manifold*> seeds;
+
+			for (auto& manifold : manifolds)
+				seeds.push_back(&manifold.second);
+
+			if (bDeterministic)
+				sort(seeds.begin(), seeds.end(), [](Manifold* a, Manifold* b)
+					{ return rank(*a) < rank(*b); });
+
+			for (Manifold* lpManifold : seeds)
+			{
+				locate(lpManifold->lpTile, lpManifold->nIndex);
+				locate(lpManifold->lpOther, lpManifold->nOther);
+
+				for (UINT i : { lpManifold->nIndex, lpManifold->nOther })
+					if (pushes(i))
+					{
+						discovered[i] = 1;
+						pending.push_back(i);
+					}
+			}
+
+			while (!pending.empty())
+			{
+				UINT i = pending.back();
+				pending.pop_back();
+
+				Tile& tile = **bodies[i];
+
+				if (tile.transform.rotation || !tile.tangible)
+					continue;
+
+				Vector lower, upper;
+				Tree::bounds(tile.transform, lower, upper);
+
+				Vector velocity = Vector(bodies.nextX[i], bodies.nextY[i]);
+				Vector reach = Vector(Tile::sleepMargin) + Vector(abs(velocity.x), abs(velocity.y)) * deltaTime;
+
+				tree.query(lower - reach, upper + reach, [&](INT nProxy)
+					{
+						UINT j = tree.order(nProxy);
+
+						if (j >= bodies.size() || j == i || !bodies.interacts(i, j))
+							return;
+
+						Tile& tile2 = **bodies[j];
+
+						if (tile2.transform.rotation || !tile2.tangible)
+							return;
+
+						RefCountedPtr<Tile>* lpOther = &resolve(j, tile.transform);
+						Pair key = bodies.tiles[i] < lpOther ? Pair(bodies.tiles[i], lpOther) : Pair(lpOther, bodies.tiles[i]);
+
+						if (manifolds.count(key))
+							return;
+
+						Vector lower2, upper2;
+						Tree::bounds(tile2.transform, lower2, upper2);
+
+						float gapX = max(lower.x - upper2.x, lower2.x - upper.x), gapY = max(lower.y - upper2.y, lower2.y - upper.y);
+
+						Vector velocity2 = bodies.has(j, Bodies::Dynamic) && !tile2.sleeping ? Vector(bodies.nextX[j], bodies.nextY[j]) : tile2.velocity;
+
+						if (max(gapX, gapY) > Tile::sleepMargin + (velocity - velocity2).length() * deltaTime)
+							return;
+
+						Vector delta = tile.transform.center() - tile2.transform.center();
+						Vector normal = gapX > gapY ? Vector(delta.x < 0.0f ? -1.0f : 1.0f, 0.0f) : Vector(0.0f, delta.y < 0.0f ? -1.0f : 1.0f);
+
+						manifolds[key] = Manifold{ bodies.tiles[i], lpOther, normal, 0.0f, 0.0f, i, lpOther == bodies.tiles[j] ? j : UINT_MAX, false };
+
+						if (pushes(j))
+						{
+							discovered[j] = 1;
+							pending.push_back(j);
+						}
+					}, bodies.masks[i]);
+			}
+		}
+
+		static void solve()
+		{
+			const float bounceThreshold = 1.0f;
+
+			supported.assign(bodies.size(), 0);
+			visited.assign(bodies.size(), 0);
+			precedence.clear();
+
+			if (!nIterations)
+				manifolds.clear();
+
+			if (manifolds.empty())
+				return;
+
+			unordered_map<RefCountedPtr<Tile>*, UINT> indices;
+
+			auto locate = [&](RefCountedPtr<Tile>* lpTile, UINT& nIndex)
+				{
+					if (nIndex < bodies.size() && bodies.tiles[nIndex] == lpTile)
+						return;
+
+					if (indices.empty())
+						for (UINT i = 0; i < bodies.size(); i++)
+							indices[bodies.tiles[i]] = i;
+
+					auto found = indices.find(lpTile);
+					nIndex = found != indices.end() ? found->second : UINT_MAX;
+				};
+
+			auto velocity = [&](UINT i)
+				{
+					if (i == UINT_MAX)
+						return Vector();
+
+					if (!bodies.has(i, Bodies::Dynamic) || bodies[i]->sleeping)
+						return Vector(bodies.velocityX[i], bodies.velocityY[i]);
+
+					return Vector(bodies.nextX[i], bodies.nextY[i]);
+				};
+
+			discover(locate);
+
+			struct Constraint
+			{
+				Manifold* lpManifold;
+				float weight, weight2, bias, friction;
+				bool bTouching;
+			};
+
+			vector<Constraint> constraints;
+
+			for (auto manifold = manifolds.begin(); manifold != manifolds.end();)
+			{
+				Manifold& current = manifold->second;
+
+				locate(current.lpTile, current.nIndex);
+				locate(current.lpOther, current.nOther);
+
+				Vector lower, upper, lower2, upper2;
+				Tree::bounds((*current.lpTile)->transform, lower, upper);
+				Tree::bounds((*current.lpOther)->transform, lower2, upper2);
+
+				float gap = max(max(lower.x - upper2.x, lower2.x - upper.x), max(lower.y - upper2.y, lower2.y - upper.y));
+				UINT i = current.nIndex, j = current.nOther;
+
+				current.bSolved = false;
+
+				if (i == UINT_MAX || gap > Tile::sleepMargin + (velocity(i) - velocity(j)).length() * deltaTime || !Tile::interacts(***current.lpTile, ***current.lpOther) || !(*current.lpTile)->tangible || !(*current.lpOther)->tangible)
+				{
+					manifold = manifolds.erase(manifold);
+					continue;
+				}
+
+				if (j != UINT_MAX && bodies.has(i, Bodies::Dynamic) && bodies.has(j, Bodies::Dynamic) && bodies[i]->sleeping != bodies[j]->sleeping && Geometry::length(bodies.velocityX[i] - bodies.velocityX[j], bodies.velocityY[i] - bodies.velocityY[j]) > Tile::sleepVelocity)
+					bodies[bodies[i]->sleeping ? i : j]->wake();
+
+				bool bYields = bodies.has(i, Bodies::Dynamic) && !bodies[i]->sleeping;
+				bool bYields2 = j != UINT_MAX && bodies.has(j, Bodies::Dynamic) && !bodies[j]->sleeping;
+				bool bPushable = bodies.has(i, Bodies::Pushable), bPushable2 = j != UINT_MAX && bodies.has(j, Bodies::Pushable);
+
+				float weight = bYields && (bPushable || !bYields2 || !bPushable2) ? 1.0f : 0.0f;
+				float weight2 = bYields2 && (bPushable2 || !bYields || !bPushable) ? 1.0f : 0.0f;
+
+				manifold++;
+
+				if (!weight && !weight2)
+					continue;
+
+				bool bTouching = gap <= Tile::sleepMargin;
+				float approach = Vector::dot(velocity(i) - velocity(j), current.normal);
+
+				if (bTouching)
+					serial.contacts.push_back(Pair(current.lpTile, current.lpOther));
+
+				current.bSolved = true;
+
+				float bias = gap > 0.0f ? -gap / deltaTime : approach < -bounceThreshold ? -approach * (*current.lpTile)->bounciness : 0.0f;
+
+				constraints.push_back(Constraint{ &current, weight, weight2, bias, (*current.lpTile)->friction, bTouching });
+			}
+
+			if (bDeterministic)
+				sort(constraints.begin(), constraints.end(), [](const Constraint& a, const Constraint& b)
+					{ return rank(*a.lpManifold) < rank(*b.lpManifold); });
+
+			auto apply = [&](Constraint& constraint, Vector impulse)
+				{
+					Manifold& manifold = *constraint.lpManifold;
+
+					bodies.nextX[manifold.nIndex] += impulse.x * constraint.weight;
+					bodies.nextY[manifold.nIndex] += impulse.y * constraint.weight;
+
+					if (manifold.nOther != UINT_MAX)
+					{
+						bodies.nextX[manifold.nOther] -= impulse.x * constraint.weight2;
+						bodies.nextY[manifold.nOther] -= impulse.y * constraint.weight2;
+					}
+				};
+
+			auto relative = [&](Manifold& manifold)
+				{ return velocity(manifold.nIndex) - velocity(manifold.nOther); };
+
+			for (Constraint& constraint : constraints)
+			{
+				Manifold& manifold = *constraint.lpManifold;
+				Vector tangent = Vector(-manifold.normal.y, manifold.normal.x);
+
+				apply(constraint, manifold.normal * manifold.normalImpulse + tangent * manifold.tangentImpulse);
+
+				if (!constraint.bTouching)
+					continue;
+
+				supported[manifold.nIndex] = 1;
+
+				if (manifold.nOther != UINT_MAX)
+					supported[manifold.nOther] = 1;
+			}
+
+			for (UINT nIteration = 0; nIteration < nIterations; nIteration++)
+				for (Constraint& constraint : constraints)
+				{
+					Manifold& manifold = *constraint.lpManifold;
+					Vector tangent = Vector(-manifold.normal.y, manifold.normal.x);
+					float mass = 1.0f / (constraint.weight + constraint.weight2);
+
+					float normalImpulse = max(manifold.normalImpulse + (constraint.bias - Vector::dot(relative(manifold), manifold.normal)) * mass, 0.0f);
+					apply(constraint, manifold.normal * (normalImpulse - manifold.normalImpulse));
+					manifold.normalImpulse = normalImpulse;
+
+					float limit = constraint.friction * manifold.normalImpulse;
+					float tangentImpulse = Math::clamp(manifold.tangentImpulse - Vector::dot(relative(manifold), tangent) * mass, -limit, limit);
+					apply(constraint, tangent * (tangentImpulse - manifold.tangentImpulse));
+					manifold.tangentImpulse = tangentImpulse;
+				}
+
+			for (Constraint& constraint : constraints)
+			{
+				Manifold& manifold = *constraint.lpManifold;
+				UINT i = manifold.nIndex, j = manifold.nOther;
+
+				if (j == UINT_MAX || !bodies.has(i, Bodies::Dynamic) || !bodies.has(j, Bodies::Dynamic) || bodies[i]->sleeping || bodies[j]->sleeping)
+					continue;
+
+				if (Vector::dot(velocity(i), manifold.normal) < 0.0f)
+					precedence.push_back(make_pair(i, j));
+
+				if (Vector::dot(velocity(j), manifold.normal) > 0.0f)
+					precedence.push_back(make_pair(j, i));
+			}
+
+			sort(precedence.begin(), precedence.end());
+		}
+
+		static void advance(UINT nIndex, Strip& strip)
+		{
+			if (visited[nIndex])
+				return;
+
+			visited[nIndex] = 1;
+
+			for (auto lead = lower_bound(precedence.begin(), precedence.end(), make_pair(nIndex, 0U)); lead != precedence.end() && lead->first == nIndex; lead++)
+				if (owners[lead->second] == owners[nIndex])
+					advance(lead->second, strip);
+
+			if (!step(nIndex, strip))
+				strip.deferred.push_back(nIndex);
+		}
+
+		static void record(vector<Pair>& touched)
+		{
+			for (Pair& pair : touched)
+			{
+				Pair key = pair.first < pair.second ? pair : Pair(pair.second, pair.first);
+				auto found = contacts.find(key);
+
+				if (found == contacts.end())
+				{
+					contacts[key] = Contact{ pair.first, pair.second, nStep };
+
+					if (bReportEnter)
+						Dispatcher::sendEvent(EventType::Enter, new LPVOID[]{ pair.first, pair.second });
+				}
+				else if (found->second.nStep != nStep)
+				{
+					found->second = Contact{ pair.first, pair.second, nStep };
+
+					if (bReportStay)
+						Dispatcher::sendEvent(EventType::Stay, new LPVOID[]{ found->second.lpTile, found->second.lpOther });
+				}
+			}
+		}
+
+		static void expire()
+		{
+			vector<pair<EventType, Contact>> pending;
+
+			for (auto contact = contacts.begin(); contact != contacts.end();)
+			{
+				Contact& current = contact->second;
+
+				if (current.nStep == nStep)
+					contact++;
+				else if ((*current.lpTile)->sleeping)
+				{
+					current.nStep = nStep;
+
+					if (bReportStay)
+						pending.push_back(make_pair(EventType::Stay, current));
+
+					contact++;
+				}
+				else
+				{
+					if (bReportExit)
+						pending.push_back(make_pair(EventType::Exit, current));
+
+					contact = contacts.erase(contact);
+				}
+			}
+
+			sort(pending.begin(), pending.end(), [](auto& a, auto& b)
+				{ return make_pair((*a.second.lpTile)->id, (*a.second.lpOther)->id) < make_pair((*b.second.lpTile)->id, (*b.second.lpOther)->id); });
+
+			for (auto& event : pending)
+				Dispatcher::sendEvent(event.first, new LPVOID[]{ event.second.lpTile, event.second.lpOther });
+		}
+
+		static void forget(RefCountedPtr<Tile>* lpTile)
+		{
+			for (auto contact = contacts.begin(); contact != contacts.end();)
+				if (contact->second.lpTile == lpTile || contact->second.lpOther == lpTile)
+					contact = contacts.erase(contact);
+				else
+					contact++;
+
+			for (auto manifold = manifolds.begin(); manifold != manifolds.end();)
+				if (manifold->second.lpTile == lpTile || manifold->second.lpOther == lpTile)
+					manifold = manifolds.erase(manifold);
+				else
+					manifold++;
+		}
+
+		static void simulateParallel()
+		{
+			pool.resize(nThreads);
+
+			partition();
+
+			bParallel = true;
+
+			for (BYTE nPhase = 0; nPhase < 2; nPhase++)
+			{
+				vector<function<void()>> tasks;
+
+				for (UINT nStrip = nPhase; nStrip < strips.size(); nStrip += 2)
+					if (!strips[nStrip].bodies.empty())
+						tasks.push_back([nStrip]()
+							{
+								Strip& strip = strips[nStrip];
+
+								for (UINT i : strip.bodies)
+									advance(i, strip);
+							});
+
+				pool.run(tasks);
+			}
+
+			bParallel = false;
+
+			for (BYTE nPhase = 0; nPhase < 2; nPhase++)
+				for (UINT nStrip = nPhase; nStrip < strips.size(); nStrip += 2)
+				{
+					Strip& strip = strips[nStrip];
+
+					if (strip.bodies.empty())
+						continue;
+
+					Dispatcher::merge(strip.events);
+					record(strip.contacts);
+					refresh(strip.touches);
+					deferred.insert(deferred.end(), strip.deferred.begin(), strip.deferred.end());
+				}
+
+			if (broadphase == (UINT)Broadphase::Grid)
+				for (UINT i = 0; i < bodies.size(); i++)
+					grid.update(i, bodies[i]->transform);
+
+			for (INT nProxy : bodies.proxies)
+				tree.move(nProxy);
+
+			for (BYTE nPhase = 0; nPhase < 2; nPhase++)
+				for (UINT nStrip = nPhase; nStrip < strips.size(); nStrip += 2)
+					for (UINT j : strips[nStrip].wakes)
+						if (bodies[j]->sleeping)
+							wake(j);
+
+			sort(deferred.begin(), deferred.end());
+
+			for (UINT i : deferred)
+			{
+				owners[i] = UINT_MAX;
+				visited[i] = 0;
+			}
+
+			for (UINT i : deferred)
+				advance(i, serial);
+
+			Dispatcher::merge(serial.events);
+			record(serial.contacts);
+			refresh(serial.touches);
+			expire();
+
+			nTests = serial.nTests;
+
+			for (Strip& strip : strips)
+				nTests += strip.nTests;
+		}
+
+	public:
+		static Vector gravity;
+		static float cellSize;
+		static UINT broadphase, nThreads, nIterations;
+		static bool bDeterministic;
+		static ULONGLONG stateHash, nTests;
+
+		static void insert(RefCountedPtr<Tile>* lpTile)
+		{
+			proxies[lpTile] = tree.insert(lpTile);
+		}
+
+		static void erase(RefCountedPtr<Tile>* lpTile)
+		{
+			if (members.count(lpTile))
+				separate(lpTile);
+
+			unmerged.erase(remove(unmerged.begin(), unmerged.end(), lpTile), unmerged.end());
+
+			tree.remove(proxies[lpTile]);
+			proxies.erase(lpTile);
+			forget(lpTile);
+		}
+
+		static void disturb(Tile& source, Transform region)
+		{
+			vector<pair<Tile*, Transform>> stack(1, make_pair(&source, region));
+
+			while (!stack.empty())
+			{
+				Tile& tile = *stack.back().first;
+				Vector lower, upper;
+				Tree::bounds(stack.back().second, lower, upper);
+				stack.pop_back();
+
+				Transform reach = Transform(lower - Vector(Tile::sleepMargin), upper - lower + Vector(Tile::sleepMargin * 2.0f), 0.0f);
+
+				tree.query(reach.position, reach.position + reach.scale, [&](INT nProxy)
+					{
+						Tile& tile2 = ***tree.tile(nProxy);
+
+						if (&tile2 == &tile || !tile2.dynamic || !tile2.sleeping || !(tile.category & tile2.mask) || !(tile2.category & tile.mask))
+							return;
+
+						Vector lower2, upper2;
+						Tree::bounds(tile2.transform, lower2, upper2);
+
+						if (!Transform::intersect(reach, Transform(lower2, upper2 - lower2, 0.0f)))
+							return;
+
+						tile2.wake();
+						tile2.bSlept = false;
+						stack.push_back(make_pair(&tile2, tile2.transform));
+					}, tile.mask);
+			}
+		}
+
+		static void clear()
+		{
+			tree.clear();
+			proxies.clear();
+			contacts.clear();
+			manifolds.clear();
+			blocks.clear();
+			merged.clear();
+			members.clear();
+			unmerged.clear();
+		}
+
+		static void rebuild(list<RefCountedPtr<Tile>>& tiles)
+		{
+			clear();
+
+			for (RefCountedPtr<Tile>& tile : tiles)
+				insert(&tile);
+		}
+
+		static void shutdown()
+		{
+			pool.resize(0);
+		}
+
+		static void refit(list<RefCountedPtr<Tile>>& tiles)
+		{
+			for (RefCountedPtr<Tile>& tile : tiles)
+				tree.move(proxies[&tile]);
+		}
+
+		static void simulate(list<RefCountedPtr<Tile>>& tiles, float elapsed)
+		{
+			if (broadphase > (UINT)Broadphase::Tree)
+				Error::raise("Invalid broadphase.");
+
+			if (!nThreads)
+				Error::raise("Invalid thread count.");
+
+			deltaTime = elapsed;
+
+			bodies.clear();
+			ordered.clear();
+
+			for (RefCountedPtr<Tile>& tile : tiles)
+				ordered.push_back(&tile);
+
+			if (bDeterministic)
+				stable_sort(ordered.begin(), ordered.end(), [](RefCountedPtr<Tile>* a, RefCountedPtr<Tile>* b)
+					{ return (*a)->id < (*b)->id; });
+
+			for (RefCountedPtr<Tile>* lpTile : ordered)
+			{
+				RefCountedPtr<Tile>& tile = *lpTile;
+
+				if (bDeterministic)
+					settle(**tile);
+
+				tree.move(proxies[lpTile]);
+
+				auto member = members.find(lpTile);
+
+				if (member == members.end())
+				{
+					if (mergeable(**tile))
+						unmerged.push_back(lpTile);
+				}
+				else if (!mergeable(**tile) || tile->transform != member->second.transform || tile->category != member->second.nCategory || tile->mask != member->second.nMask)
+					separate(lpTile);
+			}
+
+			merge();
+
+			for (RefCountedPtr<Tile>* lpTile : ordered)
+			{
+				RefCountedPtr<Tile>& tile = *lpTile;
+				INT nProxy = proxies[lpTile];
+				auto member = members.find(lpTile);
+				bool bBody = **tile && (member == members.end() || member->second.block == blocks.end());
+
+				tree.order(nProxy) = bBody ? bodies.size() : UINT_MAX;
+
+				if (bBody)
+					bodies.add(lpTile, nProxy);
+			}
+
+			for (Block& block : blocks)
+			{
+				tree.order(block.nProxy) = bodies.size();
+				bodies.add(&block.tile, block.nProxy);
+			}
+
+			bodies.pack();
+			bodies.integrate(gravity * deltaTime);
+
+			nStep++;
+			bReportPhase = Dispatcher::hooked(EventType::Phase);
+			bReportCollision = Dispatcher::hooked(EventType::Collision);
+			bReportEnter = Dispatcher::hooked(EventType::Enter);
+			bReportStay = Dispatcher::hooked(EventType::Stay);
+			bReportExit = Dispatcher::hooked(EventType::Exit);
+
+			serial.contacts.clear();
+			serial.touches.clear();
+			serial.impulses.clear();
+			serial.nTests = 0;
+
+			solve();
+
+			if (nThreads > 1 && !bDeterministic)
+			{
+				simulateParallel();
+				return;
+			}
+
+			if (broadphase == (UINT)Broadphase::Grid)
+			{
+				grid.reset(cellSize);
+
+				for (UINT i = 0; i < bodies.size(); i++)
+					grid.insert(bodies[i]->transform, linked(i));
+			}
+
+			owners.assign(bodies.size(), UINT_MAX);
+
+			for (UINT i = 0; i < bodies.size(); i++)
+				advance(i, serial);
+
+			Dispatcher::merge(serial.events);
+			record(serial.contacts);
+			refresh(serial.touches);
+			expire();
+
+			nTests = serial.nTests;
+
+			if (bDeterministic)
+				stateHash = digest();
+		}
+
+		static vector<RefCountedPtr<Tile>*> query(Transform region, UINT nMask)
+		{
+			Vector lower, upper;
+			Tree::bounds(region, lower, upper);
+			region = Transform(lower, upper - lower, 0.0f);
+
+			vector<RefCountedPtr<Tile>*> result;
+
+			tree.query(lower, upper, [&](INT nProxy)
+				{
+					RefCountedPtr<Tile>* tile = tree.tile(nProxy);
+
+					Vector tileLower, tileUpper;
+					Tree::bounds((*tile)->transform, tileLower, tileUpper);
+
+					if (**tile && !merged.count(tile) && ((*tile)->category & nMask) && Transform::intersect(region, Transform(tileLower, tileUpper - tileLower, 0.0f)))
+						result.push_back(tile);
+				}, nMask);
+
+			return result;
+		}
+
+		static void visible(Transform view, vector<RefCountedPtr<Tile>*>& result)
+		{
+			Vector lower, upper;
+			Tree::bounds(view, lower, upper);
+
+			result.clear();
+
+			tree.query(lower, upper, [&](INT nProxy)
+				{
+					RefCountedPtr<Tile>* tile = tree.tile(nProxy);
+
+					if (!merged.count(tile))
+						result.push_back(tile);
+				});
+		}
+
+		static vector<RefCountedPtr<Tile>*> queryPoint(Vector point, UINT nMask)
+		{
+			vector<RefCountedPtr<Tile>*> result;
+
+			tree.query(point, point, [&](INT nProxy)
+				{
+					RefCountedPtr<Tile>* tile = tree.tile(nProxy);
+
+					Vector tileLower, tileUpper;
+					Tree::bounds((*tile)->transform, tileLower, tileUpper);
+
+					if (**tile && !merged.count(tile) && ((*tile)->category & nMask) && Tree::distance(tileLower, tileUpper, point) == 0.0f)
+						result.push_back(tile);
+				}, nMask);
+
+			return result;
+		}
+
+		static vector<RefCountedPtr<Tile>*> raycast(Vector from, Vector to, UINT nMask)
+		{
+			vector<pair<float, RefCountedPtr<Tile>*>> hits;
+
+			tree.raycast(from, to, [&](INT nProxy)
+				{
+					RefCountedPtr<Tile>* tile = tree.tile(nProxy);
+
+					Vector tileLower, tileUpper;
+					Tree::bounds((*tile)->transform, tileLower, tileUpper);
+
+					float fraction;
+
+					if (**tile && !merged.count(tile) && ((*tile)->category & nMask) && Tree::clip(tileLower, tileUpper, from, to - from, fraction))
+						hits.push_back(make_pair(fraction, tile));
+				}, nMask);
+
+			stable_sort(hits.begin(), hits.end(), [](auto& a, auto& b)
+				{ return a.first < b.first; });
+
+			vector<RefCountedPtr<Tile>*> result;
+
+			for (auto& hit : hits)
+				result.push_back(hit.second);
+
+			return result;
+		}
+
+		static bool solid(Vector point, UINT nMask)
+		{
+			bool bSolid = false;
+
+			tree.query(point, point, [&](INT nProxy)
+				{
+					RefCountedPtr<Tile>* tile = tree.tile(nProxy);
+
+					if (bSolid || !**tile || (*tile)->dynamic || !(*tile)->tangible || !((*tile)->category & nMask))
+						return;
+
+					Vector tileLower, tileUpper, translation;
+					Tree::bounds((*tile)->transform, tileLower, tileUpper);
+
+					if ((*tile)->transform.rotation)
+						bSolid = Transform::separate(Transform(point, Vector(), 0.0f), (*tile)->transform, translation);
+					else
+						bSolid = point.x > tileLower.x && point.x < tileUpper.x && point.y > tileLower.y && point.y < tileUpper.y;
+				}, nMask);
+
+			return bSolid;
+		}
+
+		static vector<RefCountedPtr<Tile>*> nearest(Vector point, UINT nCount, UINT nMask)
+		{
+			vector<RefCountedPtr<Tile>*> result;
+
+			tree.nearest(point, nCount, [&](INT nProxy)
+				{
+					RefCountedPtr<Tile>* tile = tree.tile(nProxy);
+
+					if (!**tile || merged.count(tile) || !((*tile)->category & nMask))
+						return false;
+
+					result.push_back(tile);
+					return true;
+				}, nMask);
+
+			return result;
+		}
+
+		static void scene(list<RefCountedPtr<Tile>>& tiles, UINT nScenario, UINT nCount)
+		{
+			static BYTE lpPixel[4] = { 0xFF, 0xFF, 0xFF, 0xFF };
+
+			Image texture;
+			texture.lpPixels = lpPixel;
+			texture.nWidth = 1;
+			texture.nHeight = 1;
+			texture.lpTexture = Textures::create(lpPixel, 1, 1, false);
+
+			UINT nSide = max((UINT)sqrtf((float)nCount), 1u);
+			float width = nSide * 1.5f;
+
+			auto add = [&](Transform transform, bool bDynamic, bool bPushable, Vector velocity) -> Tile&
+				{
+					tiles.push_back(RefCountedPtr<Tile>(new Tile(transform, texture, bDynamic, true, bPushable, 0.2f, 0.1f, velocity)));
+					return **tiles.back();
+				};
+
+			switch (nScenario)
+			{
+			case 0:
+				add(Transform(Vector(-1.0f, -1.0f), Vector(width + 2.0f, 1.0f), 0.0f), false, false, Vector());
+
+				for (UINT i = 1; i < nCount; i++)
+					add(Transform(Vector((i % nSide) * 1.5f, (i / nSide) * 1.5f), Vector(1.0f), 0.0f), true, false, Vector());
+				break;
+			case 1:
+				for (UINT i = 0; i < nCount; i++)
+					if (i % 100)
+						add(Transform(Vector((float)(i % nSide), -(float)(i / nSide)), Vector(1.0f), 0.0f), false, false, Vector());
+					else
+						add(Transform(Vector((float)(i / 100 % nSide) + 0.1f, 2.0f + (i / 100 / nSide) * 2.0f), Vector(0.8f), 0.0f), true, false, Vector());
+				break;
+			case 2:
+				add(Transform(Vector(-1.0f, -1.0f), Vector(width + 2.0f, 1.0f), 0.0f), false, false, Vector());
+				add(Transform(Vector(-1.0f, width), Vector(width + 2.0f, 1.0f), 0.0f), false, false, Vector());
+				add(Transform(Vector(-1.0f, 0.0f), Vector(1.0f, width), 0.0f), false, false, Vector());
+				add(Transform(Vector(width, 0.0f), Vector(1.0f, width), 0.0f), false, false, Vector());
+
+				for (UINT i = 4; i < nCount; i++)
+					add(Transform(Vector((i % nSide) * 1.5f, (i / nSide) * 1.5f), Vector(0.2f), 0.0f), true, false, Vector(Math::random(-60.0f, 60.0f), Math::random(-60.0f, 60.0f))).bullet = true;
+				break;
+			case 3:
+				for (UINT i = 0; i < nCount; i++)
+				{
+					float x = (float)(i % nSide), y = (i / nSide) * 3.0f;
+
+					if (!(i % nSide))
+						add(Transform(Vector(-1.0f, y - 1.0f), Vector(nSide + 2.0f, 1.0f), 0.0f), false, false, Vector());
+					else
+						add(Transform(Vector(x, y), Vector(0.95f), 0.0f), true, true, Vector(i % nSide == 1 ? 20.0f : 0.0f, 0.0f));
+				}
+				break;
+			}
+		}
+
+		static double measure(list<RefCountedPtr<Tile>>& tiles, UINT nSteps, ULONGLONG& nTotalTests)
+		{
+			State state = State();
+			list<Event> pending;
+
+			exchange(state);
+			Dispatcher::exchange(pending);
+
+			rebuild(tiles);
+			nTotalTests = 0;
+
+			auto start = chrono::steady_clock::now();
+
+			for (UINT i = 0; i < nSteps; i++)
+			{
+				refit(tiles);
+				simulate(tiles, 1.0f / 60.0f);
+
+				nTotalTests += nTests;
+
+				for (EventType type : { EventType::Phase, EventType::Collision, EventType::Enter, EventType::Stay, EventType::Exit })
+					Dispatcher::discard(type);
+			}
+
+			double elapsed = chrono::duration<double, nano>(chrono::steady_clock::now() - start).count();
+
+			exchange(state);
+			Dispatcher::exchange(pending);
+
+			return elapsed;
+		}
+
+		static void profile(LPCSTR lpFilePath)
+		{
+			LPCSTR lpScenarios[] = { "crates", "floor", "bullets", "chains" };
+			FILE* lpFile = nullptr;
+
+			if (fopen_s(&lpFile, lpFilePath, "w") || !lpFile)
+				Error::raise("Failed to open benchmark output.");
+
+			fprintf(lpFile, "{\n\t\"results\": [");
+
+			srand(1);
+
+			for (UINT nScenario = 0; nScenario < 4; nScenario++)
+				for (UINT nCount = 100; nCount <= 100000; nCount *= 10)
+				{
+					list<RefCountedPtr<Tile>> tiles;
+
+					scene(tiles, nScenario, nCount);
+
+					UINT nSteps = max(min(1000000u / nCount, 600u), 10u);
+					ULONGLONG nTotalTests = 0;
+					double elapsed = measure(tiles, nSteps, nTotalTests);
+
+					fprintf(lpFile, "%s\n\t\t{ \"scenario\": \"%s\", \"tiles\": %u, \"steps\": %u, \"threads\": %u, \"broadphase\": %u, \"nsPerTileStep\": %.2f, \"pairTestsPerStep\": %.2f }",
+						nScenario || nCount > 100 ? "," : "", lpScenarios[nScenario], (UINT)tiles.size(), nSteps, nThreads, broadphase, elapsed / ((double)nSteps * tiles.size()), (double)nTotalTests / nSteps);
+				}
+
+			fprintf(lpFile, "\n\t]\n}\n");
+			fclose(lpFile);
+		}
+	};
+
+	Vector Physics::gravity = Vector(0.0f, -9.82f);
+	float Physics::cellSize = 1.0f;
+	UINT Physics::broadphase = (UINT)Broadphase::Grid;
+	Grid Physics::grid = Grid();
+	Tree Physics::tree = Tree();
+	unordered_map<RefCountedPtr<Tile>*, INT> Physics::proxies = unordered_map<RefCountedPtr<Tile>*, INT>();
+	Bodies Physics::bodies = Bodies();
+	UINT Physics::nThreads = 1;
+	UINT Physics::nIterations = 8;
+	Pool Physics::pool = Pool();
+	bool Physics::bParallel = false;
+	vector<Transform> Physics::reaches = vector<Transform>();
+	vector<Physics::Strip> Physics::strips = vector<Physics::Strip>();
+	vector<UINT> Physics::deferred = vector<UINT>();
+	Physics::Strip Physics::serial = Physics::Strip();
+	unordered_map<Physics::Pair, Physics::Contact, Physics::PairHash> Physics::contacts = unordered_map<Physics::Pair, Physics::Contact, Physics::PairHash>();
+	ULONGLONG Physics::nStep = 0;
+	bool Physics::bReportPhase = true;
+	bool Physics::bReportCollision = true;
+	bool Physics::bReportEnter = true;
+	bool Physics::bReportStay = true;
+	bool Physics::bReportExit = true;
+	bool Physics::bDeterministic = false;
+	ULONGLONG Physics::stateHash = 0;
+	ULONGLONG Physics::nTests = 0;
+	float Physics::deltaTime = 0.0f;
+	vector<RefCountedPtr<Tile>*> Physics::ordered = vector<RefCountedPtr<Tile>*>();
+	unordered_map<Physics::Pair, Physics::Manifold, Physics::PairHash> Physics::manifolds = unordered_map<Physics::Pair, Physics::Manifold, Physics::PairHash>();
+	vector<BYTE> Physics::supported = vector<BYTE>();
+	vector<BYTE> Physics::visited = vector<BYTE>();
+	vector<UINT> Physics::owners = vector<UINT>();
+	vector<pair<UINT, UINT>> Physics::precedence = vector<pair<UINT, UINT>>();
+	list<Physics::Block> Physics::blocks = list<Physics::Block>();
+	unordered_map<RefCountedPtr<Tile>*, list<Physics::Block>::iterator> Physics::merged = unordered_map<RefCountedPtr<Tile>*, list<Physics::Block>::iterator>();
+	unordered_map<RefCountedPtr<Tile>*, Physics::Member> Physics::members = unordered_map<RefCountedPtr<Tile>*, Physics::Member>();
+	vector<RefCountedPtr<Tile>*> Physics::unmerged = vector<RefCountedPtr<Tile>*>();
+
+	class Emitter
+	{
+	public:
+		struct Vertex
+		{
+			float x, y, u, v;
+			BYTE lpColor[4];
+		};
+
+		struct Batch
+		{
+			Image texture;
+			vector<Vertex> vertices;
+		};
+
+	private:
+		vector<float> positionX, positionY, velocityX, velocityY, age, life;
+		float spawn;
+
+		static BYTE blend(ULONG uStart, ULONG uEnd, BYTE nShift, float time)
+		{
+			return (BYTE)((uStart >> nShift & 0xFF) + ((float)(uEnd >> nShift & 0xFF) - (float)(uStart >> nShift & 0xFF)) * time);
+		}
+
+		void integrate(float deltaTime)
+		{
+			UINT nCount = count(), i = 0;
+			Vector impulse = gravity * deltaTime;
+
+#ifdef __AVX__
+			__m256 impulseX8 = _mm256_set1_ps(impulse.x), impulseY8 = _mm256_set1_ps(impulse.y), deltaTime8 = _mm256_set1_ps(deltaTime);
+
+			for (; i + 8 <= nCount; i += 8)
+			{
+				__m256 nextX = _mm256_add_ps(_mm256_loadu_ps(&velocityX[i]), impulseX8), nextY = _mm256_add_ps(_mm256_loadu_ps(&velocityY[i]), impulseY8);
+
+				_mm256_storeu_ps(&velocityX[i], nextX);
+				_mm256_storeu_ps(&velocityY[i], nextY);
+				_mm256_storeu_ps(&age[i], _mm256_add_ps(_mm256_loadu_ps(&age[i]), deltaTime8));
+
+				if (!collide)
+				{
+					_mm256_storeu_ps(&positionX[i], _mm256_add_ps(_mm256_loadu_ps(&positionX[i]), _mm256_mul_ps(nextX, deltaTime8)));
+					_mm256_storeu_ps(&positionY[i], _mm256_add_ps(_mm256_loadu_ps(&positionY[i]), _mm256_mul_ps(nextY, deltaTime8)));
+				}
+			}
+#endif
+
+			__m128 impulseX = _mm_set1_ps(impulse.x), impulseY = _mm_set1_ps(impulse.y), deltaTime4 = _mm_set1_ps(deltaTime);
+
+			for (; i + 4 <= nCount; i += 4)
+			{
+				__m128 nextX = _mm_add_ps(_mm_loadu_ps(&velocityX[i]), impulseX), nextY = _mm_add_ps(_mm_loadu_ps(&velocityY[i]), impulseY);
+
+				_mm_storeu_ps(&velocityX[i], nextX);
+				_mm_storeu_ps(&velocityY[i], nextY);
+				_mm_storeu_ps(&age[i], _mm_add_ps(_mm_loadu_ps(&age[i]), deltaTime4));
+
+				if (!collide)
+				{
+					_mm_storeu_ps(&positionX[i], _mm_add_ps(_mm_loadu_ps(&positionX[i]), _mm_mul_ps(nextX, deltaTime4)));
+					_mm_storeu_ps(&positionY[i], _mm_add_ps(_mm_loadu_ps(&positionY[i]), _mm_mul_ps(nextY, deltaTime4)));
+				}
+			}
+
+			for (; i < nCount; i++)
+			{
+				velocityX[i] += impulse.x;
+				velocityY[i] += impulse.y;
+				age[i] += deltaTime;
+
+				if (!collide)
+				{
+					positionX[i] += velocityX[i] * deltaTime;
+					positionY[i] += velocityY[i] * deltaTime;
+				}
+			}
+		}
+
+		void bounce(float deltaTime)
+		{
+			for (UINT i = 0; i < count(); i++)
+			{
+				positionX[i] += velocityX[i] * deltaTime;
+
+				if (Physics::solid(Vector(positionX[i], positionY[i]), mask))
+				{
+					positionX[i] -= velocityX[i] * deltaTime;
+					velocityX[i] *= -bounciness;
+				}
+
+				positionY[i] += velocityY[i] * deltaTime;
+
+				if (Physics::solid(Vector(positionX[i], positionY[i]), mask))
+				{
+					positionY[i] -= velocityY[i] * deltaTime;
+					velocityY[i] *= -bounciness;
+					velocityX[i] *= 1.0f - friction;
+				}
+			}
+		}
+
+		void expire()
+		{
+			UINT nCount = count();
+
+			for (UINT i = 0; i < nCount;)
+				if (age[i] >= life[i])
+				{
+					nCount--;
+
+					for (vector<float>* lpArray : { &positionX, &positionY, &velocityX, &velocityY, &age, &life })
+						(*lpArray)[i] = (*lpArray)[nCount];
+				}
+				else
+					i++;
+
+			for (vector<float>* lpArray : { &positionX, &positionY, &velocityX, &velocityY, &age, &life })
+				lpArray->resize(nCount);
+		}
+
+	public:
+		Vector position, area;
+		Image texture;
+		float rate;
+		Vector lifetime, velocityMin, velocityMax, gravity, size, opacity;
+		ULONG uStartColor, uEndColor;
+		bool active, collide;
+		float bounciness, friction;
+		UINT mask, capacity;
+
+		Emitter(Vector position, Image texture) : spawn(0.0f), position(position), area(Vector()), texture(texture), rate(10.0f), lifetime(Vector(1.0f, 1.0f)), velocityMin(Vector(-1.0f, -1.0f)), velocityMax(Vector(1.0f, 1.0f)), gravity(Vector()), size(Vector(0.1f, 0.1f)), opacity(Vector(1.0f, 0.0f)), uStartColor(0xFFFFFF), uEndColor(0xFFFFFF), active(true), collide(false), bounciness(0.5f), friction(0.1f), mask(UINT_MAX), capacity(1000) {}
+
+		Emitter() : Emitter(Vector(), Image()) {}
+
+		UINT count()
+		{
+			return (UINT)age.size();
+		}
+
+		void burst(UINT nCount)
+		{
+			nCount = min(nCount, capacity > count() ? capacity - count() : 0u);
+
+			for (UINT i = 0; i < nCount; i++)
+			{
+				positionX.push_back(position.x + Math::random(0.0f, area.x));
+				positionY.push_back(position.y + Math::random(0.0f, area.y));
+				velocityX.push_back(Math::random(velocityMin.x, velocityMax.x));
+				velocityY.push_back(Math::random(velocityMin.y, velocityMax.y));
+				age.push_back(0.0f);
+				life.push_back(Math::random(lifetime.x, lifetime.y));
+			}
+		}
+
+		void clear()
+		{
+			for (vector<float>* lpArray : { &positionX, &positionY, &velocityX, &velocityY, &age, &life })
+				lpArray->clear();
+
+			spawn = 0.0f;
+		}
+
+		void update(float deltaTime)
+		{
+			if (active)
+			{
+				spawn += rate * deltaTime;
+				burst((UINT)spawn);
+				spawn -= floorf(spawn);
+			}
+
+			integrate(deltaTime);
+
+			if (collide)
+				bounce(deltaTime);
+
+			expire();
+		}
+
+		void record(Batch& batch)
+		{
+			UINT nCount = count();
+
+			batch.texture = texture;
+			batch.vertices.resize(nCount * 4);
+
+			Vector lower = Vector(0.0f, 0.0f), upper = Vector(1.0f, 1.0f);
+			vector<Vertex>& vertices = batch.vertices;
+
+			for (UINT i = 0; i < nCount; i++)
+			{
+				float time = life[i] > 0.0f ? min(age[i] / life[i], 1.0f) : 1.0f;
+				float extent = (size.x + (size.y - size.x) * time) * 0.5f;
+				BYTE lpColor[4] = { blend(uStartColor, uEndColor, 16, time), blend(uStartColor, uEndColor, 8, time), blend(uStartColor, uEndColor, 0, time), (BYTE)(Math::clamp(opacity.x + (opacity.y - opacity.x) * time, 0.0f, 1.0f) * 255.0f) };
+
+				Vertex* lpVertex = &vertices[i * 4];
+
+				lpVertex[0] = Vertex{ positionX[i] - extent, positionY[i] + extent, lower.x, lower.y };
+				lpVertex[1] = Vertex{ positionX[i] - extent, positionY[i] - extent, lower.x, upper.y };
+				lpVertex[2] = Vertex{ positionX[i] + extent, positionY[i] - extent, upper.x, upper.y };
+				lpVertex[3] = Vertex{ positionX[i] + extent, positionY[i] + extent, upper.x, lower.y };
+
+				for (BYTE k = 0; k < 4; k++)
+					memcpy(lpVertex[k].lpColor, lpColor, sizeof(lpColor));
+			}
+		}
+
+		static void render(Batch& batch)
+		{
+			vector<Vertex>& vertices = batch.vertices;
+
+			if (vertices.empty())
+				return;
+
+			Vector lower, upper;
+			GLuint glTexture = batch.texture ? batch.texture.locate(lower, upper) : GL_NONE;
+
+			if (glTexture)
+				for (Vertex& vertex : vertices)
+				{
+					vertex.u = lower.x + (upper.x - lower.x) * vertex.u;
+					vertex.v = lower.y + (upper.y - lower.y) * vertex.v;
+				}
+
+			glBindTexture(GL_TEXTURE_2D, glTexture);
+
+			glEnableClientState(GL_VERTEX_ARRAY);
+			glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+			glEnableClientState(GL_COLOR_ARRAY);
+
+			glVertexPointer(2, GL_FLOAT, sizeof(Vertex), &vertices[0].x);
+			glTexCoordPointer(2, GL_FLOAT, sizeof(Vertex), &vertices[0].u);
+			glColorPointer(4, GL_UNSIGNED_BYTE, sizeof(Vertex), vertices[0].lpColor);
+
+			glDrawArrays(GL_QUADS, 0, (GLsizei)vertices.size());
+
+			glDisableClientState(GL_COLOR_ARRAY);
+			glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+			glDisableClientState(GL_VERTEX_ARRAY);
+
+			glColor4f(1.0f, 1.0f, 1.0f, 1.0f);
+		}
+
+		operator bool()
+		{
+			return capacity && (active || count());
+		}
+
+		operator LPCSTR()
+		{
+			LPSTR lpString = new CHAR[256];
+			sprintf_s(lpString, 256, "(%s, %s, %f, %u)", position.operator LPCSTR(), texture.operator LPCSTR(), rate, count());
+			return lpString;
+		}
+
+		static void luaModule(Namespace flat)
+		{
+			flat.beginClass<Emitter>("emitter")
+				.addConstructor<void (*)(Vector, Image)>()
+				.addData("position", &Emitter::position)
+				.addData("area", &Emitter::area)
+				.addData("texture", &Emitter::texture)
+				.addData("rate", &Emitter::rate)
+				.addData("lifetime", &Emitter::lifetime)
+				.addData("velocityMin", &Emitter::velocityMin)
+				.addData("velocityMax", &Emitter::velocityMax)
+				.addData("gravity", &Emitter::gravity)
+				.addData("size", &Emitter::size)
+				.addData("opacity", &Emitter::opacity)
+				.addData("startColor", &Emitter::uStartColor)
+				.addData("endColor", &Emitter::uEndColor)
+				.addData("active", &Emitter::active)
+				.addData("collide", &Emitter::collide)
+				.addData("bounciness", &Emitter::bounciness)
+				.addData("friction", &Emitter::friction)
+				.addData("mask", &Emitter::mask)
+				.addData("capacity", &Emitter::capacity)
+				.addFunction<UINT>("count", &count)
+				.addFunction<void, UINT>("burst", &burst)
+				.addFunction<void>("clear", &clear)
+				.addFunction<LPCSTR>("__tostring", &operator LPCSTR)
+				.endClass()
+				.endNamespace();
+		}
+	};
+
+	class Batcher
+	{
+	private:
+		struct Vertex
+		{
+			float x, y, u, v;
+		};
+
+	public:
+		struct Entry
+		{
+			ULONGLONG nKey;
+			UINT nIndex;
+		};
+
+		struct Sprite
+		{
+			Transform transform;
+			Image texture;
+			INT layer;
+			UINT nSequence;
+		};
+
+	private:
+		Batcher() {}
+
+		static vector<Entry> sprites, scratch;
+		static vector<GLuint> textures;
+		static vector<Vertex> vertices;
+		static GLuint glBuffer;
+		static size_t nCapacity;
+
+	public:
+		static UINT nDrawCalls, nSprites;
+
+		static ULONGLONG key(INT nLayer, UINT nGroup, UINT nSequence)
+		{
+			nLayer = max(SHRT_MIN, min(SHRT_MAX, nLayer));
+
+			return (ULONGLONG)(nLayer - SHRT_MIN) << 48 | (ULONGLONG)(nGroup & 0xFFFF) << 32 | nSequence;
+		}
+
+		static void sort(vector<Entry>& entries)
+		{
+			if (entries.empty())
+				return;
+
+			size_t lpCounts[8][256] = {};
+
+			for (Entry& entry : entries)
+				for (BYTE k = 0; k < 8; k++)
+					lpCounts[k][entry.nKey >> k * 8 & 0xFF]++;
+
+			scratch.resize(entries.size());
+
+			for (BYTE k = 0; k < 8; k++)
+			{
+				if (lpCounts[k][entries[0].nKey >> k * 8 & 0xFF] == entries.size())
+					continue;
+
+				for (size_t nBucket = 0, nOffset = 0; nBucket < 256; nBucket++)
+				{
+					size_t nCount = lpCounts[k][nBucket];
+					lpCounts[k][nBucket] = nOffset;
+					nOffset += nCount;
+				}
+
+				for (Entry& entry : entries)
+					scratch[lpCounts[k][entry.nKey >> k * 8 & 0xFF]++] = entry;
+
+				entries.swap(scratch);
+			}
+		}
+
+		static void begin()
+		{
+			sprites.clear();
+			textures.clear();
+			vertices.clear();
+		}
+
+		static void draw(Transform transform, GLuint glTexture, Vector lower, Vector upper, INT nLayer, UINT nSequence)
+		{
+			Vector extent = transform.scale * 0.5f, center = transform.position + extent;
+			Vector corners[4] = { Vector(-extent.x, extent.y), Vector(-extent.x, -extent.y), Vector(extent.x, -extent.y), extent };
+			float lpCoordinates[4][2] = { { lower.x, lower.y }, { lower.x, upper.y }, { upper.x, upper.y }, { upper.x, lower.y } };
+
+			if (transform.rotation)
+				for (Vector& corner : corners)
+					corner.rotate(transform.rotation);
+
+			sprites.push_back(Entry{ key(nLayer, glTexture, nSequence), (UINT)sprites.size() });
+			textures.push_back(glTexture);
+
+			for (BYTE k : { 0, 1, 2, 0, 2, 3 })
+				vertices.push_back(Vertex{ center.x + corners[k].x, center.y + corners[k].y, lpCoordinates[k][0], lpCoordinates[k][1] });
+		}
+
+		static void draw(Sprite& sprite)
+		{
+			Vector lower, upper;
+			GLuint glTexture = sprite.texture.locate(lower, upper);
+
+			draw(sprite.transform, glTexture, lower, upper, sprite.layer, sprite.nSequence);
+		}
+
+		static void flush()
+		{
+			nSprites = (UINT)sprites.size();
+			nDrawCalls = 0;
+
+			if (sprites.empty())
+				return;
+
+			sort(sprites);
+
+			vector<Vertex> sorted;
+			sorted.reserve(vertices.size());
+
+			for (Entry& sprite : sprites)
+				sorted.insert(sorted.end(), vertices.begin() + sprite.nIndex * 6, vertices.begin() + sprite.nIndex * 6 + 6);
+
+			if (!glBuffer)
+				glGenBuffers(1, &glBuffer);
+
+			glBindBuffer(GL_ARRAY_BUFFER, glBuffer);
+
+			if (sorted.size() > nCapacity)
+				nCapacity = sorted.size() * 2;
+
+			glBufferData(GL_ARRAY_BUFFER, nCapacity * sizeof(Vertex), nullptr, GL_STREAM_DRAW);
+
+			glBufferSubData(GL_ARRAY_BUFFER, 0, sorted.size() * sizeof(Vertex), sorted.data());
+
+			glEnableClientState(GL_VERTEX_ARRAY);
+			glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+
+			glVertexPointer(2, GL_FLOAT, sizeof(Vertex), (LPVOID)offsetof(Vertex, x));
+			glTexCoordPointer(2, GL_FLOAT, sizeof(Vertex), (LPVOID)offsetof(Vertex, u));
+
+			for (UINT nStart = 0, nEnd; nStart < sprites.size(); nStart = nEnd)
+			{
+				GLuint glTexture = textures[sprites[nStart].nIndex];
+
+				for (nEnd = nStart + 1; nEnd < sprites.size() && sprites[nEnd].nKey >> 32 == sprites[nStart].nKey >> 32 && textures[sprites[nEnd].nIndex] == glTexture; nEnd++);
+
+				glBindTexture(GL_TEXTURE_2D, glTexture);
+				glDrawArrays(GL_TRIANGLES, nStart * 6, (nEnd - nStart) * 6);
+
+				nDrawCalls++;
+			}
+
+			glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+			glDisableClientState(GL_VERTEX_ARRAY);
+
+			glBindBuffer(GL_ARRAY_BUFFER, GL_NONE);
+		}
+
+		static void destroy()
+		{
+			if (glBuffer)
+				glDeleteBuffers(1, &glBuffer);
+
+			glBuffer = GL_NONE;
+			nCapacity = 0;
+		}
+	};
+
+	vector<Batcher::Entry> Batcher::sprites = vector<Batcher::Entry>();
+	vector<Batcher::Entry> Batcher::scratch = vector<Batcher::Entry>();
+	vector<GLuint> Batcher::textures = vector<GLuint>();
+	vector<Batcher::Vertex> Batcher::vertices = vector<Batcher::Vertex>();
+	GLuint Batcher::glBuffer = GL_NONE;
+	size_t Batcher::nCapacity = 0;
+	UINT Batcher::nDrawCalls = 0;
+	UINT Batcher::nSprites = 0;
+
+	class Backdrop
+	{
+	public:
+		struct Request
+		{
+			ULONGLONG nGeneration;
+			Vector lower, upper;
+			UINT nWidth, nHeight;
+			vector<Batcher::Sprite> sprites;
+		};
+
+	private:
+		Backdrop() {}
+
+		static GLuint glFramebuffer, glTexture;
+		static UINT nWidth, nHeight, nTextureWidth, nTextureHeight;
+		static Vector lower, upper, scale, builtLower, builtUpper;
+		static UINT nRepacks;
+		static ULONGLONG nGeneration;
+		static atomic<ULONGLONG> nBuilt;
+		static atomic<bool> bValid;
+		static vector<RefCountedPtr<Tile>*> candidates;
+
+		static void build(Request& request, UINT nWindowWidth, UINT nWindowHeight)
+		{
+			GLint nMaximum = 0, glTarget = 0;
+			glGetIntegerv(GL_MAX_TEXTURE_SIZE, &nMaximum);
+			glGetIntegerv(GL_FRAMEBUFFER_BINDING, &glTarget);
+
+			UINT nNewWidth = min(request.nWidth, (UINT)nMaximum), nNewHeight = min(request.nHeight, (UINT)nMaximum);
+
+			if (!glFramebuffer)
+			{
+				glGenFramebuffers(1, &glFramebuffer);
+				glGenTextures(1, &glTexture);
+			}
+
+			glBindTexture(GL_TEXTURE_2D, glTexture);
+
+			if (nNewWidth != nTextureWidth || nNewHeight != nTextureHeight)
+			{
+				nTextureWidth = nNewWidth;
+				nTextureHeight = nNewHeight;
+
+				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP);
+				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP);
+				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+				glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, nTextureWidth, nTextureHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+
+				glBindFramebuffer(GL_FRAMEBUFFER, glFramebuffer);
+				glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, glTexture, 0);
+
+				if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+					Error::raise("Failed to create the backdrop framebuffer.");
+			}
+
+			glBindFramebuffer(GL_FRAMEBUFFER, glFramebuffer);
+			glViewport(0, 0, nTextureWidth, nTextureHeight);
+
+			glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+			glClear(GL_COLOR_BUFFER_BIT);
+
+			glLoadIdentity();
+			glOrtho(request.lower.x, request.upper.x, request.lower.y, request.upper.y, -1.0, 1.0);
+
+			nRepacks = Atlas::nRepacks;
+			Batcher::begin();
+
+			for (Batcher::Sprite& sprite : request.sprites)
+				Batcher::draw(sprite);
+
+			glBlendFuncSeparate(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA, GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+			Batcher::flush();
+			glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+			glBindFramebuffer(GL_FRAMEBUFFER, glTarget);
+			glViewport(0, 0, nWindowWidth, nWindowHeight);
+			glLoadIdentity();
+
+			builtLower = request.lower;
+			builtUpper = request.upper;
+			nBuilt = request.nGeneration;
+		}
+
+	public:
+		static bool enabled;
+		static float margin;
+		static UINT nRebuilds;
+
+		static bool cached(RefCountedPtr<Tile>& tile)
+		{
+			return enabled && tile->cached && !tile->dynamic;
+		}
+
+		static void invalidate()
+		{
+			bValid = false;
+		}
+
+		static void update(Transform camera, UINT nWindowWidth, UINT nWindowHeight, Request& request)
+		{
+			request.sprites.clear();
+			request.nGeneration = 0;
+
+			if (!enabled || !nWindowWidth || !nWindowHeight || !camera.scale.x || !camera.scale.y)
+			{
+				bValid = false;
+				return;
+			}
+
+			Vector viewLower, viewUpper;
+			Tree::bounds(camera, viewLower, viewUpper);
+
+			if (!bValid || !(camera.scale == scale) || viewLower.x < lower.x || viewLower.y < lower.y || viewUpper.x > upper.x || viewUpper.y > upper.y)
+			{
+				Vector extent = (viewUpper - viewLower) * max(margin, 0.0f);
+				lower = viewLower - extent;
+				upper = viewUpper + extent;
+				scale = camera.scale;
+
+				Vector density = Vector(nWindowWidth / fabsf(camera.scale.x), nWindowHeight / fabsf(camera.scale.y));
+				nWidth = (UINT)ceilf((upper.x - lower.x) * density.x);
+				nHeight = (UINT)ceilf((upper.y - lower.y) * density.y);
+
+				bValid = true;
+				nGeneration++;
+				nRebuilds++;
+			}
+
+			request.nGeneration = nGeneration;
+			request.lower = lower;
+			request.upper = upper;
+			request.nWidth = nWidth;
+			request.nHeight = nHeight;
+
+			if (nBuilt == nGeneration)
+				return;
+
+			Physics::visible(Transform(lower, upper - lower, 0.0f), candidates);
+
+			for (RefCountedPtr<Tile>* lpTile : candidates)
+				if (RefCountedPtr<Tile>& tile = *lpTile; **tile && cached(tile))
+					request.sprites.push_back(Batcher::Sprite{ tile->transform, tile->texture, tile->layer, (UINT)tile->nOrder });
+		}
+
+		static void render(Request& request, UINT nWindowWidth, UINT nWindowHeight)
+		{
+			if (!request.nGeneration)
+				return;
+
+			if (request.nGeneration > nBuilt)
+				build(request, nWindowWidth, nWindowHeight);
+
+			if (nRepacks != Atlas::nRepacks)
+				bValid = false;
+		}
+
+		static void draw(Request& request)
+		{
+			if (!request.nGeneration || request.nGeneration != nBuilt)
+				return;
+
+			glBindTexture(GL_TEXTURE_2D, glTexture);
+			glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+
+			glBegin(GL_QUADS);
+			glTexCoord2f(0.0f, 0.0f);
+			glVertex2f(builtLower.x, builtLower.y);
+			glTexCoord2f(1.0f, 0.0f);
+			glVertex2f(builtUpper.x, builtLower.y);
+			glTexCoord2f(1.0f, 1.0f);
+			glVertex2f(builtUpper.x, builtUpper.y);
+			glTexCoord2f(0.0f, 1.0f);
+			glVertex2f(builtLower.x, builtUpper.y);
+			glEnd();
+
+			glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+		}
+
+		static void destroy()
+		{
+			if (glFramebuffer)
+			{
+				glDeleteFramebuffers(1, &glFramebuffer);
+				glDeleteTextures(1, &glTexture);
+			}
+
+			glFramebuffer = GL_NONE;
+			glTexture = GL_NONE;
+			nTextureWidth = nTextureHeight = 0;
+			nBuilt = 0;
+			bValid = false;
+		}
+	};
+
+	GLuint Backdrop::glFramebuffer = GL_NONE;
+	GLuint Backdrop::glTexture = GL_NONE;
+	UINT Backdrop::nWidth = 0;
+	UINT Backdrop::nHeight = 0;
+	UINT Backdrop::nTextureWidth = 0;
+	UINT Backdrop::nTextureHeight = 0;
+	Vector Backdrop::lower = Vector();
+	Vector Backdrop::upper = Vector();
+	Vector Backdrop::scale = Vector();
+	Vector Backdrop::builtLower = Vector();
+	Vector Backdrop::builtUpper = Vector();
+	UINT Backdrop::nRepacks = 0;
+	ULONGLONG Backdrop::nGeneration = 0;
+	atomic<ULONGLONG> Backdrop::nBuilt = 0;
+	atomic<bool> Backdrop::bValid = false;
+	vector<RefCountedPtr<Tile>*> Backdrop::candidates = vector<RefCountedPtr<Tile>*>();
+	bool Backdrop::enabled = true;
+	float Backdrop::margin = 0.5f;
+	UINT Backdrop::nRebuilds = 0;
+
+	class Renderer
+	{
+	public:
+		struct Caption
+		{
+			Vector position;
+			float scale;
+			ULONG uColor;
+			INT layer;
+			shared_ptr<Text::Run> run;
+		};
+
+		struct Frame
+		{
+			ULONGLONG nSequence;
+			Transform camera;
+			UINT nWidth, nHeight;
+			vector<Batcher::Sprite> sprites;
+			vector<Emitter::Batch> emitters;
+			vector<Caption> captions;
+			Backdrop::Request backdrop;
+		};
+
+	private:
+		Renderer() {}
+
+		static Frame frames[3];
+		static UINT nBack, nReady, nFront;
+		static ULONGLONG nSequence;
+		static bool bFresh, bStopping;
+		static mutex lock;
+		static condition_variable wakeup;
+		static thread worker;
+		static GLFWwindow* glWindow;
+		static vector<Batcher::Entry> queue;
+		static GLuint glTarget, glColor;
+		static UINT nTargetWidth, nTargetHeight;
+		static string capturePath;
+
+		static void save(LPCSTR lpFilePath, UINT nWidth, UINT nHeight)
+		{
+			vector<BYTE> pixels((size_t)nWidth * nHeight * 4);
+
+			glPixelStorei(GL_PACK_ALIGNMENT, 1);
+			glReadPixels(0, 0, nWidth, nHeight, GL_BGRA, GL_UNSIGNED_BYTE, pixels.data());
+
+			BITMAPINFOHEADER info = {};
+			info.biSize = sizeof(info);
+			info.biWidth = nWidth;
+			info.biHeight = nHeight;
+			info.biPlanes = 1;
+			info.biBitCount = 32;
+			info.biCompression = BI_RGB;
+			info.biSizeImage = (DWORD)pixels.size();
+
+			BITMAPFILEHEADER header = {};
+			header.bfType = 0x4D42;
+			header.bfOffBits = sizeof(header) + sizeof(info);
+			header.bfSize = header.bfOffBits + info.biSizeImage;
+
+			FILE* lpFile = nullptr;
+
+			if (fopen_s(&lpFile, lpFilePath, "wb") || !lpFile)
+				Error::raise("Failed to open capture output.");
+
+			fwrite(&header, sizeof(header), 1, lpFile);
+			fwrite(&info, sizeof(info), 1, lpFile);
+			fwrite(pixels.data(), 1, pixels.size(), lpFile);
+			fclose(lpFile);
+		}
+
+		static void render(Frame& frame)
+		{
+			UINT nWidth = frame.nWidth, nHeight = frame.nHeight;
+
+			glBindFramebuffer(GL_FRAMEBUFFER, glTarget);
+			glViewport(0, 0, nWidth, nHeight);
+
+			glUseProgram(GL_NONE);
+
+			glLoadIdentity();
+			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+			Atlas::update();
+			Backdrop::render(frame.backdrop, nWidth, nHeight);
+
+			Transform scaledCamera = frame.camera;
+
+			scaledCamera.scale *= 0.5f;
+			scaledCamera.position += scaledCamera.scale;
+			scaledCamera.position *= -1.0f;
+			scaledCamera.rotation = Math::normalize(scaledCamera.rotation, 180.0f);
+
+			glScalef(1.0f / scaledCamera.scale.x, 1.0f / scaledCamera.scale.y, 0.0f);
+			glRotatef(Math::normalize(scaledCamera.rotation, 180), 0.0f, 0.0f, 1.0f);
+			glTranslatef(scaledCamera.position.x, scaledCamera.position.y, 0.0f);
+
+			Backdrop::draw(frame.backdrop);
+
+			Batcher::begin();
+
+			for (Batcher::Sprite& sprite : frame.sprites)
+				Batcher::draw(sprite);
+
+			Batcher::flush();
+
+			for (Emitter::Batch& batch : frame.emitters)
+				Emitter::render(batch);
+
+			Textures::collect(frame.nSequence);
+
+			Text::begin();
+
+			nVisibleLabels = 0;
+			queue.clear();
+
+			for (UINT i = 0; i < frame.captions.size(); i++)
+				queue.push_back(Batcher::Entry{ Batcher::key(frame.captions[i].layer, 0, i), i });
+
+			Batcher::sort(queue);
+
+			for (Batcher::Entry& entry : queue)
+			{
+				Caption& caption = frame.captions[entry.nIndex];
+				Text::Run& run = *caption.run;
+
+				Vector scaledPosition = Vector(1.0f + (caption.position.x + scaledCamera.position.x) / scaledCamera.scale.x, 1.0f - (caption.position.y + scaledCamera.position.y) / scaledCamera.scale.y) * Vector(nWidth, nHeight) * 0.5f;
+				float scaledScale = caption.scale * caption.scale / scaledCamera.scale.length() / gltGetLineHeight(caption.scale) * Geometry::length(nWidth, nHeight) * 0.5f;
+
+				if (scaledPosition.x >= nWidth || scaledPosition.x + run.width * scaledScale <= 0.0f || scaledPosition.y <= 0.0f || scaledPosition.y - run.height * scaledScale >= nHeight)
+					continue;
+
+				Text::draw(run, Vector(scaledPosition.x, scaledPosition.y - run.height * scaledScale), scaledScale, caption.uColor);
+
+				nVisibleLabels++;
+			}
+
+			Text::flush(nWidth, nHeight);
+
+			string path;
+
+			{
+				lock_guard<mutex> guard(lock);
+				path.swap(capturePath);
+			}
+
+			if (!path.empty())
+				save(path.c_str(), nWidth, nHeight);
+
+			if (glTarget)
+				glFinish();
+			else
+				glfwSwapBuffers(glWindow);
+		}
+
+		static void run()
+		{
+			glfwMakeContextCurrent(glWindow);
+
+			if (nTargetWidth && nTargetHeight)
+			{
+				glGenFramebuffers(1, &glTarget);
+				glGenRenderbuffers(1, &glColor);
+
+				glBindRenderbuffer(GL_RENDERBUFFER, glColor);
+				glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, nTargetWidth, nTargetHeight);
+
+				glBindFramebuffer(GL_FRAMEBUFFER, glTarget);
+				glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, glColor);
+
+				if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+					Error::raise("Failed to create the offscreen framebuffer.");
+			}
+
+			while (true)
+			{
+				{
+					unique_lock<mutex> guard(lock);
+					wakeup.wait(guard, []()
+						{ return bStopping || bFresh; });
+
+					if (bStopping)
+						break;
+
+					swap(nFront, nReady);
+					bFresh = false;
+				}
+
+				render(frames[nFront]);
+			}
+
+			for (Frame& frame : frames)
+				frame = Frame();
+
+			Textures::collect(ULLONG_MAX);
+			Batcher::destroy();
+			Backdrop::destroy();
+			Text::destroy();
+			Atlas::reset();
+			gltTerminate();
+
+			if (glTarget)
+			{
+				glBindFramebuffer(GL_FRAMEBUFFER, GL_NONE);
+				glDeleteFramebuffers(1, &glTarget);
+				glDeleteRenderbuffers(1, &glColor);
+			}
+
+			glTarget = GL_NONE;
+			glColor = GL_NONE;
+
+			glfwMakeContextCurrent(nullptr);
+		}
+
+	public:
+		static UINT nVisibleLabels;
+
+		static Frame& back()
+		{
+			return frames[nBack];
+		}
+
+		static void publish()
+		{
+			lock_guard<mutex> guard(lock);
+
+			frames[nBack].nSequence = ++nSequence;
+			swap(nBack, nReady);
+			bFresh = true;
+
+			Textures::nEpoch = nSequence + 1;
+			wakeup.notify_one();
+		}
 
-	bool Network::bRunning = false;
-	Server Network::server = Server();
-	USHORT Network::port = 0;
-	USHORT Network::clientPort = 0;
-	HANDLE Network::hListener = nullptr;
-	string Network::request = string();
-	string Network::response = string();
-	string Network::clientIP = string();
-	bool Network::bServed = false;
+		static void capture(LPCSTR lpFilePath)
+		{
+			lock_guard<mutex> guard(lock);
+			capturePath = lpFilePath;
+		}
 
-	void exit()
-	{
-		ExitProcess(0);
-	}
+		static void start(GLFWwindow* glNewWindow, UINT nOffscreenWidth, UINT nOffscreenHeight)
+		{
+			glWindow = glNewWindow;
+			nTargetWidth = nOffscreenWidth;
+			nTargetHeight = nOffscreenHeight;
+			nSequence = 0;
+			bFresh = false;
+			bStopping = false;
+			Textures::nEpoch = 1;
+
+			glfwMakeContextCurrent(nullptr);
+			worker = thread(run);
+		}
+
+		static void stop()
+		{
+			{
+				lock_guard<mutex> guard(lock);
+				bStopping = true;
+				wakeup.notify_one();
+			}
+
+			if (worker.joinable())
+				worker.join();
+		}
+	};
+
+	Renderer::Frame Renderer::frames[3] = {};
+	UINT Renderer::nBack = 0;
+	UINT Renderer::nReady = 1;
+	UINT Renderer::nFront = 2;
+	ULONGLONG Renderer::nSequence = 0;
+	bool Renderer::bFresh = false;
+	bool Renderer::bStopping = false;
+	mutex Renderer::lock;
+	condition_variable Renderer::wakeup;
+	thread Renderer::worker;
+	GLFWwindow* Renderer::glWindow = nullptr;
+	vector<Batcher::Entry> Renderer::queue = vector<Batcher::Entry>();
+	GLuint Renderer::glTarget = GL_NONE;
+	GLuint Renderer::glColor = GL_NONE;
+	UINT Renderer::nTargetWidth = 0;
+	UINT Renderer::nTargetHeight = 0;
+	string Renderer::capturePath = string();
+	UINT Renderer::nVisibleLabels = 0;
 
 	class Engine
 	{
@@ -1547,14 +6211,23 @@ namespace Flat
 		static bool bRunning;
 		static list<RefCountedPtr<Tile>> tiles;
 		static list<RefCountedPtr<Label>> labels;
+		static list<RefCountedPtr<Emitter>> emitters;
+		static list<RefCountedPtr<Tween>> tweens;
 		static float fps, time, deltaTime, renderTime;
-		static Vector gravity;
+		static float tickRate, accumulator, alpha;
+		static UINT maxSubsteps;
+		static ULONGLONG nNextId, nNextOrder;
 		static Lua lua;
 		static GLFWwindow* glWindow;
 		static bool lpKeys[GLFW_KEY_LAST + 1], lpButtons[GLFW_MOUSE_BUTTON_LAST + 2];
 		static Vector cursorPosition;
 		static ULONGLONG nFrames;
 		static Transform camera;
+		static Vector motion;
+		static vector<RefCountedPtr<Tile>*> visibleTiles;
+		static UINT nVisibleTiles;
+		static bool headless;
+		static UINT nOffscreenWidth, nOffscreenHeight;
 
 		static void errorCallback(INT nCode, LPCSTR lpDescription)
 		{
@@ -1599,14 +6272,88 @@ namespace Flat
 			Dispatcher::sendEvent(EventType::Mouse, new INT[]{ GLFW_MOUSE_BUTTON_LAST + 1, y > 0 ? GLFW_PRESS : GLFW_RELEASE });
 		}
 
+		static void tick()
+		{
+			time += deltaTime;
+
+			for (RefCountedPtr<Tile>& tile : tiles)
+				tile->lastTransform = tile->transform;
+
+			Physics::refit(tiles);
+
+			Dispatcher::sendEvent(EventType::Update, nullptr);
+			Dispatcher::pollEvents(lua, EventType::Update);
+
+			bool bReportFinish = Dispatcher::hooked(EventType::Finish);
+
+			for (RefCountedPtr<Tween>& tween : tweens)
+			{
+				if (tween->tile && tween->active && !tween->finished())
+				{
+					if (tween->tile->cached)
+						Backdrop::invalidate();
+
+					Physics::disturb(**tween->tile, tween->tile->transform);
+				}
+
+				if (tween->update(deltaTime) && bReportFinish)
+					Dispatcher::sendEvent(EventType::Finish, new LPVOID[]{ tween.get() });
+			}
+
+			for (RefCountedPtr<Tile>& tile : tiles)
+				if (!tile->dynamic && !(tile->transform == tile->lastTransform))
+				{
+					Physics::disturb(**tile, tile->lastTransform);
+					Physics::disturb(**tile, tile->transform);
+				}
+
+			Physics::simulate(tiles, deltaTime);
+
+			motion = Vector();
+
+			if (tickRate)
+				for (RefCountedPtr<Tile>& tile : tiles)
+					if (!(tile->transform == tile->lastTransform))
+					{
+						Vector lower, upper, lastLower, lastUpper;
+						Tree::bounds(tile->transform, lower, upper);
+						Tree::bounds(tile->lastTransform, lastLower, lastUpper);
+
+						motion.x = max(motion.x, max(fabsf(lower.x - lastLower.x), fabsf(upper.x - lastUpper.x)));
+						motion.y = max(motion.y, max(fabsf(lower.y - lastLower.y), fabsf(upper.y - lastUpper.y)));
+					}
+
+			for (RefCountedPtr<Emitter>& emitter : emitters)
+				emitter->update(deltaTime);
+
+			Dispatcher::pollEvents(lua, EventType::Phase);
+			Dispatcher::pollEvents(lua, EventType::Collision);
+			Dispatcher::pollEvents(lua, EventType::Enter);
+			Dispatcher::pollEvents(lua, EventType::Stay);
+			Dispatcher::pollEvents(lua, EventType::Exit);
+			Dispatcher::pollEvents(lua, EventType::Finish);
+
+			tweens.remove_if([](RefCountedPtr<Tween>& tween)
+				{ return tween->finished(); });
+		}
+
 		static void main(LPCSTR lpGameScript)
 		{
 			time = 0.0f;
 			deltaTime = 0.0f;
 			renderTime = 0.0f;
+			accumulator = 0.0f;
+			alpha = 1.0f;
+			motion = Vector();
+			nNextId = 0;
+			nNextOrder = 0;
+			Physics::stateHash = 0;
 
 			tiles.clear();
 			labels.clear();
+			emitters.clear();
+			tweens.clear();
+			Physics::clear();
 			Dispatcher::reset();
 
 			srand(::time(nullptr));
@@ -1617,39 +6364,58 @@ namespace Flat
 			glfwSetErrorCallback(errorCallback);
 
 			GLFWmonitor* glMonitor = glfwGetPrimaryMonitor();
-			GLFWvidmode* glVideoMode = (GLFWvidmode*)glfwGetVideoMode(glMonitor);
+			GLFWvidmode* glVideoMode = glMonitor ? (GLFWvidmode*)glfwGetVideoMode(glMonitor) : nullptr;
+
+			if (!headless && !glVideoMode)
+				Error::raise("Failed to find a display.");
 
 			glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 2);
 			glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 1);
 
-			glfwWindowHint(GLFW_RED_BITS, glVideoMode->redBits);
-			glfwWindowHint(GLFW_GREEN_BITS, glVideoMode->greenBits);
-			glfwWindowHint(GLFW_BLUE_BITS, glVideoMode->blueBits);
+			if (glVideoMode)
+			{
+				glfwWindowHint(GLFW_RED_BITS, glVideoMode->redBits);
+				glfwWindowHint(GLFW_GREEN_BITS, glVideoMode->greenBits);
+				glfwWindowHint(GLFW_BLUE_BITS, glVideoMode->blueBits);
+			}
 
 			glfwWindowHint(GLFW_ALPHA_BITS, 8);
 			glfwWindowHint(GLFW_DEPTH_BITS, 24);
 			glfwWindowHint(GLFW_STENCIL_BITS, 8);
 
-			glfwWindowHint(GLFW_FLOATING, GL_TRUE);
-
-			glWindow = glfwCreateWindow(glVideoMode->width * 0.75, glVideoMode->height * 0.75, "Flat " FLAT_VERSION_STRING, nullptr, nullptr);
+			if (headless)
+			{
+				glfwWindowHint(GLFW_VISIBLE, GL_FALSE);
+				glWindow = glfwCreateWindow(nOffscreenWidth, nOffscreenHeight, "Flat " FLAT_VERSION_STRING, nullptr, nullptr);
+			}
+			else
+			{
+				glfwWindowHint(GLFW_FLOATING, GL_TRUE);
+				glWindow = glfwCreateWindow(glVideoMode->width * 0.75, glVideoMode->height * 0.75, "Flat " FLAT_VERSION_STRING, nullptr, nullptr);
+			}
 
 			if (!glWindow)
 				Error::raise("Failed to create window.");
 
 			glfwMakeContextCurrent(glWindow);
-			glfwShowWindow(glWindow);
 
-			glfwSetWindowAttrib(glWindow, GLFW_FLOATING, GL_FALSE);
+			if (!headless)
+			{
+				glfwShowWindow(glWindow);
+				glfwSetWindowAttrib(glWindow, GLFW_FLOATING, GL_FALSE);
+			}
 
 			if (glewInit())
 				Error::raise("Failed to initialize GLEW.");
 
+			if (headless && !glGenFramebuffers)
+				Error::raise("Headless mode requires framebuffer object support.");
+
 			if (!gltInit())
 				Error::raise("Failed to initialize GLText.");
 
 			nFrames = 0;
-			fps = glVideoMode->refreshRate;
+			fps = glVideoMode ? glVideoMode->refreshRate : 60.0f;
 			camera = Transform(Vector(-1.0f, -1.0f), Vector(2.0f, 2.0f), 0.0f);
 
 			Stopwatch updateStopwatch, renderStopwatch;
@@ -1665,6 +6431,8 @@ namespace Flat
 
 			glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
+			Renderer::start(glWindow, headless ? nOffscreenWidth : 0, headless ? nOffscreenHeight : 0);
+
 			lua = Lua();
 
 			lua.loadModule(&Date::luaModule);
@@ -1681,6 +6449,8 @@ namespace Flat
 			lua.loadModule(&Image::luaModule);
 			lua.loadModule(&Tile::luaModule);
 			lua.loadModule(&Label::luaModule);
+			lua.loadModule(&Emitter::luaModule);
+			lua.loadModule(&Tween::luaModule);
 			lua.loadModule(&Dispatcher::luaModule);
 			lua.loadModule(&Network::luaModule);
 			lua.loadModule(&Engine::luaModule);
@@ -1696,8 +6466,7 @@ namespace Flat
 
 			while (!glfwWindowShouldClose(glWindow))
 			{
-				deltaTime = Math::clamp(updateStopwatch.elapsed(), 0.0f, 1.0f);
-				time += deltaTime;
+				float frameTime = Math::clamp(updateStopwatch.elapsed(), 0.0f, 1.0f);
 
 				updateStopwatch.reset();
 
@@ -1710,70 +6479,44 @@ namespace Flat
 				Dispatcher::pollEvents(lua, EventType::Keyboard);
 				Dispatcher::pollEvents(lua, EventType::Mouse);
 
-				Dispatcher::sendEvent(EventType::Update, nullptr);
-				Dispatcher::pollEvents(lua, EventType::Update);
-
-				for (RefCountedPtr<Tile>& tile : tiles)
-					if (**tile)
-					{
-						if (!tile->dynamic)
-							continue;
-
-						tile->velocity += gravity * deltaTime;
-
-						Vector movement = tile->velocity * deltaTime;
-
-						tile->transform.position.x += movement.x;
-
-						for (RefCountedPtr<Tile>& tile2 : tiles)
-							if (**tile2)
-								if (tile->transform != tile2->transform && Transform::intersect(tile->transform, tile2->transform))
-								{
-									if (Tile::phase(**tile, **tile2))
-										Dispatcher::sendEvent(EventType::Phase, new LPVOID[]{ &tile, &tile2 });
-									else
-									{
-										Vector impulse = (tile->velocity + tile2->velocity) * Vector(0.5f, 0.0f);
-
-										Dispatcher::sendEvent(EventType::Collision, new LPVOID[]{ &tile, &tile2, &impulse });
-
-										tile->transform.position.x -= movement.x;
+				if (tickRate < 0.0f)
+					Error::raise("Invalid tick rate.");
 
-										if (tile2->pushable)
-											tile2->velocity.x = impulse.x;
+				if (!maxSubsteps)
+					Error::raise("Invalid substep count.");
 
-										tile->velocity.x = -tile->velocity.x * tile->bounciness;
-										tile->velocity.y -= tile->velocity.y * tile->friction;
-									}
-								}
+				if (Physics::bDeterministic && !tickRate)
+					Error::raise("Deterministic mode requires a tick rate.");
 
-						tile->transform.position.y += movement.y;
+				if (tickRate)
+				{
+					float tickTime = 1.0f / tickRate;
+					UINT nSubsteps = 0;
 
-						for (RefCountedPtr<Tile>& tile2 : tiles)
-							if (**tile2)
-								if (tile->transform != tile2->transform && Transform::intersect(tile->transform, tile2->transform))
-								{
-									if (Tile::phase(**tile, **tile2))
-										Dispatcher::sendEvent(EventType::Phase, new LPVOID[]{ &tile, &tile2 });
-									else
-									{
-										Vector impulse = (tile->velocity + tile2->velocity) * Vector(0.0f, 0.5f);
+					accumulator += frameTime;
 
-										Dispatcher::sendEvent(EventType::Collision, new LPVOID[]{ &tile, &tile2, &impulse });
+					while (accumulator >= tickTime && nSubsteps < maxSubsteps)
+					{
+						deltaTime = tickTime;
+						tick();
 
-										tile->transform.position.y -= movement.y;
+						accumulator -= tickTime;
+						nSubsteps++;
+					}
 
-										if (tile2->pushable)
-											tile2->velocity.y = impulse.y;
+					if (accumulator >= tickTime)
+						accumulator = fmodf(accumulator, tickTime);
 
-										tile->velocity.y = -tile->velocity.y * tile->bounciness;
-										tile->velocity.x -= tile->velocity.x * tile->friction;
-									}
-								}
-					}
+					alpha = accumulator / tickTime;
+				}
+				else
+				{
+					deltaTime = frameTime;
+					tick();
 
-				Dispatcher::pollEvents(lua, EventType::Phase);
-				Dispatcher::pollEvents(lua, EventType::Collision);
+					accumulator = 0.0f;
+					alpha = 1.0f;
+				}
 
 				renderTimer.delay = 1.0f / fps;
 
@@ -1785,92 +6528,69 @@ namespace Flat
 					Dispatcher::sendEvent(EventType::Render, nullptr);
 					Dispatcher::pollEvents(lua, EventType::Render);
 
-					UINT nWidth, nHeight;
-					glfwGetWindowSize(glWindow, (INT*)&nWidth, (INT*)&nHeight);
+					UINT nWidth = nOffscreenWidth, nHeight = nOffscreenHeight;
 
-					glViewport(0, 0, nWidth, nHeight);
-					gltViewport(nWidth, nHeight);
+					if (!headless)
+						glfwGetWindowSize(glWindow, (INT*)&nWidth, (INT*)&nHeight);
 
-					glUseProgram(GL_NONE);
+					Renderer::Frame& frame = Renderer::back();
+					frame.camera = camera;
+					frame.nWidth = nWidth;
+					frame.nHeight = nHeight;
 
-					glLoadIdentity();
-					glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+					Vector viewLower, viewUpper;
+					Tree::bounds(camera, viewLower, viewUpper);
 
-					Transform scaledCamera = camera;
+					Physics::visible(Transform(viewLower - motion, viewUpper - viewLower + motion * 2.0f, 0.0f), visibleTiles);
 
-					scaledCamera.scale *= 0.5f;
-					scaledCamera.position += scaledCamera.scale;
-					scaledCamera.position *= -1.0f;
-					scaledCamera.rotation = Math::normalize(scaledCamera.rotation, 180.0f);
+					for (RefCountedPtr<Tile>* lpTile : visibleTiles)
+						if (Backdrop::cached(*lpTile) && !((*lpTile)->transform == (*lpTile)->lastTransform))
+							Backdrop::invalidate();
 
-					glScalef(1.0f / scaledCamera.scale.x, 1.0f / scaledCamera.scale.y, 0.0f);
-					glRotatef(Math::normalize(scaledCamera.rotation, 180), 0.0f, 0.0f, 1.0f);
-					glTranslatef(scaledCamera.position.x, scaledCamera.position.y, 0.0f);
+					Backdrop::update(camera, nWidth, nHeight, frame.backdrop);
 
-					for (RefCountedPtr<Tile>& tile : tiles)
-						if (**tile)
-						{
-							if (!tile->texture.glId)
-							{
-								glGenTextures(1, &tile->texture.glId);
-								glBindTexture(GL_TEXTURE_2D, tile->texture.glId);
+					frame.sprites.clear();
+					nVisibleTiles = 0;
 
-								glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP);
-								glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP);
-								glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-								glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+					for (RefCountedPtr<Tile>* lpTile : visibleTiles)
+						if (RefCountedPtr<Tile>& tile = *lpTile; **tile)
+						{
+							Transform renderTransform = tile->transform;
 
-								glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, tile->texture.nWidth, tile->texture.nHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE, tile->texture.lpPixels);
+							if (tickRate)
+							{
+								renderTransform = tile->lastTransform;
+								renderTransform.interpolate(tile->transform, alpha);
 							}
 
-							glPushMatrix();
+							Vector tileLower, tileUpper;
+							Tree::bounds(renderTransform, tileLower, tileUpper);
 
-							Transform scaledTransform = tile->transform;
-							scaledTransform.scale *= 0.5f;
-							scaledTransform.position += scaledTransform.scale;
-							scaledTransform.rotation = Math::normalize(scaledTransform.rotation, 180.0f);
+							if (tileLower.x > viewUpper.x || tileUpper.x < viewLower.x || tileLower.y > viewUpper.y || tileUpper.y < viewLower.y)
+								continue;
 
-							glTranslatef(scaledTransform.position.x, scaledTransform.position.y, 0.0f);
-							glRotatef(tile->transform.rotation, 0.0f, 0.0f, 1.0f);
+							nVisibleTiles++;
 
-							glBindTexture(GL_TEXTURE_2D, tile->texture.glId);
+							if (frame.backdrop.nGeneration && Backdrop::cached(tile))
+								continue;
 
-							glBegin(GL_QUADS);
-
-							glVertex2f(-scaledTransform.scale.x, scaledTransform.scale.y);
-							glTexCoord2f(0.0f, 1.0f);
-							glVertex2f(-scaledTransform.scale.x, -scaledTransform.scale.y);
-							glTexCoord2f(1.0f, 1.0f);
-							glVertex2f(scaledTransform.scale.x, -scaledTransform.scale.y);
-							glTexCoord2f(1.0f, 0.0f);
-							glVertex2f(scaledTransform.scale.x, scaledTransform.scale.y);
-							glTexCoord2f(0.0f, 0.0f);
+							frame.sprites.push_back(Batcher::Sprite{ renderTransform, tile->texture, tile->layer, (UINT)tile->nOrder });
+						}
 
-							glEnd();
+					frame.emitters.resize(emitters.size());
+					auto batch = frame.emitters.begin();
 
-							glPopMatrix();
-						}
+					for (RefCountedPtr<Emitter>& emitter : emitters)
+						emitter->record(*batch++);
 
-					gltBeginDraw();
+					frame.captions.clear();
 
 					for (RefCountedPtr<Label>& label : labels)
 						if (**label)
-						{
-							if (!label->gltText)
-							{
-								label->gltText = gltCreateText();
-								gltSetText(label->gltText, label->lpText);
-							}
+							frame.captions.push_back(Renderer::Caption{ label->position, label->scale, label->uColor, label->layer, label->layout() });
 
-							Vector scaledPosition = Vector(1.0f + (label->position.x + scaledCamera.position.x) / scaledCamera.scale.x, 1.0f - (label->position.y + scaledCamera.position.y) / scaledCamera.scale.y) * Vector(nWidth, nHeight) * 0.5f;
-							float scaledScale = label->scale * label->scale / scaledCamera.scale.length() / gltGetLineHeight(label->scale) * Geometry::length(nWidth, nHeight) * 0.5f;
-
-							gltColor((float)(label->uColor >> 16 & 0xFF) / 255.0f, (float)(label->uColor >> 8 & 0xFF) / 255.0f, (float)(label->uColor & 0xFF) / 255.0f, 1.0f);
-							gltDrawText2DAligned(label->gltText, scaledPosition.x, scaledPosition.y, scaledScale, GLT_LEFT, GLT_BOTTOM);
-						}
-
-					gltEndDraw();
-					glfwSwapBuffers(glWindow);
+					Text::collect();
+					Renderer::publish();
 
 					renderTimer.reset();
 				}
@@ -1894,9 +6614,13 @@ namespace Flat
 
 			tiles.clear();
 			labels.clear();
+			emitters.clear();
+			tweens.clear();
+			Physics::clear();
+			Physics::shutdown();
+			Renderer::stop();
 
 			glfwTerminate();
-			gltTerminate();
 			bRunning = false;
 		}
 
@@ -1914,14 +6638,36 @@ namespace Flat
 		{
 			if (!bRunning)
 				Error::raise("Engine is not running.");
+			if (!tile->id)
+				tile->id = ++nNextId;
+
+			tile->nOrder = ++nNextOrder;
+			tile->lastTransform = tile->transform;
+
+			if (tile->cached)
+				Backdrop::invalidate();
+
 			tiles.push_back(tile);
+			Physics::insert(&tiles.back());
 		}
 
 		static void removeTile(RefCountedPtr<Tile> tile)
 		{
 			if (!bRunning)
 				Error::raise("Engine is not running.");
-			tiles.remove(tile);
+
+			if (tile->cached)
+				Backdrop::invalidate();
+
+			for (auto front = tiles.begin(); front != tiles.end();)
+				if (*front == tile)
+				{
+					Physics::disturb(**tile, tile->transform);
+					Physics::erase(&*front);
+					front = tiles.erase(front);
+				}
+				else
+					front++;
 		}
 
 		static RefCountedPtr<Tile> getTile(ULONGLONG nIndex)
@@ -1971,6 +6717,96 @@ namespace Flat
 			if (!bRunning)
 				Error::raise("Engine is not running.");
 			tiles.clear();
+			Physics::clear();
+			Backdrop::invalidate();
+		}
+
+		static LuaRef benchmark(UINT nSteps, lua_State* L)
+		{
+			if (!bRunning)
+				Error::raise("Engine is not running.");
+
+			UINT nSavedThreads = Physics::nThreads;
+
+			LuaRef table = newTable(L);
+
+			for (UINT n = 1; n <= max(thread::hardware_concurrency(), 1u); n *= 2)
+			{
+				list<RefCountedPtr<Tile>> scene;
+
+				for (RefCountedPtr<Tile>& tile : tiles)
+					scene.push_back(RefCountedPtr<Tile>(new Tile(**tile)));
+
+				Physics::nThreads = n;
+
+				ULONGLONG nTotalTests = 0;
+				table[n] = (float)(Physics::measure(scene, nSteps, nTotalTests) / 1e9 / max(nSteps, 1u));
+			}
+
+			Physics::nThreads = nSavedThreads;
+
+			return table;
+		}
+
+		static LuaRef found(vector<RefCountedPtr<Tile>*>& result, lua_State* L)
+		{
+			LuaRef table = newTable(L);
+
+			for (UINT i = 0; i < result.size(); i++)
+				table[i + 1] = *result[i];
+
+			return table;
+		}
+
+		static UINT layers(LuaRef mask)
+		{
+			if (mask.isNil())
+				return UINT_MAX;
+
+			if (!mask.isNumber())
+				Error::raise("Invalid mask.");
+
+			return mask.cast<UINT>();
+		}
+
+		static LuaRef queryTiles(Transform region, LuaRef mask, lua_State* L)
+		{
+			if (!bRunning)
+				Error::raise("Engine is not running.");
+
+			Physics::refit(tiles);
+			vector<RefCountedPtr<Tile>*> result = Physics::query(region, layers(mask));
+			return found(result, L);
+		}
+
+		static LuaRef queryPoint(Vector point, LuaRef mask, lua_State* L)
+		{
+			if (!bRunning)
+				Error::raise("Engine is not running.");
+
+			Physics::refit(tiles);
+			vector<RefCountedPtr<Tile>*> result = Physics::queryPoint(point, layers(mask));
+			return found(result, L);
+		}
+
+		static LuaRef raycast(Vector from, Vector to, LuaRef mask, lua_State* L)
+		{
+			if (!bRunning)
+				Error::raise("Engine is not running.");
+
+			Physics::refit(tiles);
+			vector<RefCountedPtr<Tile>*> result = Physics::raycast(from, to, layers(mask));
+			return found(result, L);
+		}
+
+		static LuaRef nearest(Vector point, UINT nCount, LuaRef mask, lua_State* L)
+		{
+			if (!bRunning)
+				Error::raise("Engine is not running.");
+
+			Physics::refit(tiles);
+			vector<RefCountedPtr<Tile>*> result = Physics::nearest(point, nCount, layers(mask));
+			return found(result, L);
 		}
 
 		static void resetLabels()
@@ -1980,6 +6816,80 @@ namespace Flat
 			labels.clear();
 		}
 
+		static void addEmitter(RefCountedPtr<Emitter> emitter)
+		{
+			if (!bRunning)
+				Error::raise("Engine is not running.");
+			emitters.push_back(emitter);
+		}
+
+		static void removeEmitter(RefCountedPtr<Emitter> emitter)
+		{
+			if (!bRunning)
+				Error::raise("Engine is not running.");
+			emitters.remove(emitter);
+		}
+
+		static RefCountedPtr<Emitter> getEmitter(ULONGLONG nIndex)
+		{
+			if (!bRunning)
+				Error::raise("Engine is not running.");
+
+			if (!nIndex || nIndex > emitters.size())
+				Error::raise("Invalid emitter index.");
+
+			auto front = emitters.begin();
+			advance(front, nIndex - 1);
+
+			return *front;
+		}
+
+		static void resetEmitters()
+		{
+			if (!bRunning)
+				Error::raise("Engine is not running.");
+			emitters.clear();
+		}
+
+		static void addTween(RefCountedPtr<Tween> tween)
+		{
+			if (!bRunning)
+				Error::raise("Engine is not running.");
+
+			if (!**tween)
+				Error::raise("Invalid tween.");
+
+			tweens.push_back(tween);
+		}
+
+		static void removeTween(RefCountedPtr<Tween> tween)
+		{
+			if (!bRunning)
+				Error::raise("Engine is not running.");
+			tweens.remove(tween);
+		}
+
+		static RefCountedPtr<Tween> getTween(ULONGLONG nIndex)
+		{
+			if (!bRunning)
+				Error::raise("Engine is not running.");
+
+			if (!nIndex || nIndex > tweens.size())
+				Error::raise("Invalid tween index.");
+
+			auto front = tweens.begin();
+			advance(front, nIndex - 1);
+
+			return *front;
+		}
+
+		static void resetTweens()
+		{
+			if (!bRunning)
+				Error::raise("Engine is not running.");
+			tweens.clear();
+		}
+
 		static void playSound(LPCSTR lpSound)
 		{
 			if (!bRunning)
@@ -2088,6 +6998,27 @@ namespace Flat
 			return lpButtons[nButton];
 		}
 
+		static void offscreen(UINT nWidth, UINT nHeight)
+		{
+			if (bRunning)
+				Error::raise("Engine is already running.");
+
+			if (!nWidth || !nHeight)
+				Error::raise("Invalid offscreen size.");
+
+			headless = true;
+			Error::bHeadless = true;
+			nOffscreenWidth = nWidth;
+			nOffscreenHeight = nHeight;
+		}
+
+		static void capture(LPCSTR lpFilePath)
+		{
+			if (!bRunning)
+				Error::raise("Engine is not running.");
+			Renderer::capture(lpFilePath);
+		}
+
 		static void join()
 		{
 			if (!bRunning)
@@ -2105,6 +7036,16 @@ namespace Flat
 			return labels.size();
 		}
 
+		static int emitterCount()
+		{
+			return emitters.size();
+		}
+
+		static int tweenCount()
+		{
+			return tweens.size();
+		}
+
 		static void luaModule(Namespace flat)
 		{
 			flat.beginNamespace("engine")
@@ -2112,13 +7053,59 @@ namespace Flat
 				.addVariable("fps", &fps)
 				.addVariable("deltaTime", &deltaTime, false)
 				.addVariable("renderTime", &renderTime, false)
-				.addVariable("gravity", &gravity)
+				.addVariable("tickRate", &tickRate)
+				.addVariable("maxSubsteps", &maxSubsteps)
+				.addVariable("alpha", &alpha, false)
+				.addVariable("deterministic", &Physics::bDeterministic)
+				.addVariable("hash", &Physics::stateHash, false)
+				.addVariable("gravity", &Physics::gravity)
+				.addVariable("cellSize", &Physics::cellSize)
+				.addVariable("broadphase", &Physics::broadphase)
+				.addVariable("threads", &Physics::nThreads)
+				.addVariable("iterations", &Physics::nIterations)
+				.addVariable("drawCalls", &Batcher::nDrawCalls, false)
+				.addVariable("sprites", &Batcher::nSprites, false)
+				.addVariable("visibleTiles", &nVisibleTiles, false)
+				.addVariable("visibleLabels", &Renderer::nVisibleLabels, false)
+				.addVariable("headless", &headless, false)
+				.addFunction<void, LPCSTR>("capture", &capture)
+				.beginNamespace("backdrop")
+				.addVariable("enabled", &Backdrop::enabled)
+				.addVariable("margin", &Backdrop::margin)
+				.addVariable("rebuilds", &Backdrop::nRebuilds, false)
+				.addFunction<void>("invalidate", &Backdrop::invalidate)
+				.endNamespace()
+				.beginNamespace("text")
+				.addVariable("cacheSize", &Text::nCacheSize)
+				.addVariable("glyphs", &Text::nGlyphs, false)
+				.addVariable("layouts", &Text::nLayouts, false)
+				.addFunction<UINT>("count", &Text::count)
+				.endNamespace()
+				.beginNamespace("textures")
+				.addVariable("budget", &Textures::nBudget)
+				.addVariable("resident", &Textures::nResident, false)
+				.addFunction<UINT>("count", &Textures::count)
+				.endNamespace()
+				.beginNamespace("atlas")
+				.addVariable("pageSize", &Atlas::nPageSize)
+				.addVariable("repacks", &Atlas::nRepacks, false)
+				.addFunction<UINT>("pages", &Atlas::count)
+				.endNamespace()
+				.addFunction<LuaRef, UINT, lua_State*>("benchmark", &benchmark)
+				.beginNamespace("broadphases")
+				.addConstant("grid", (UINT)Broadphase::Grid)
+				.addConstant("tree", (UINT)Broadphase::Tree)
+				.endNamespace()
 				.beginNamespace("tile")
 				.addFunction<void, RefCountedPtr<Tile>>("add", &addTile)
 				.addFunction<void, RefCountedPtr<Tile>>("remove", &removeTile)
 				.addFunction<RefCountedPtr<Tile>, ULONGLONG>("get", &getTile)
 				.addFunction<void>("reset", &resetTiles)
 				.addFunction<int>("count", &tileCount)
+				.addFunction<LuaRef, Transform, LuaRef, lua_State*>("query", &queryTiles)
+				.addFunction<LuaRef, Vector, LuaRef, lua_State*>("queryPoint", &queryPoint)
+				.addFunction<LuaRef, Vector, Vector, LuaRef, lua_State*>("raycast", &raycast)
+				.addFunction<LuaRef, Vector, UINT, LuaRef, lua_State*>("nearest", &nearest)
 				.endNamespace()
 				.beginNamespace("label")
 				.addFunction<void, RefCountedPtr<Label>>("add", &addLabel)
@@ -2127,6 +7114,31 @@ namespace Flat
 				.addFunction<void>("reset", &resetLabels)
 				.addFunction<int>("count", &labelCount)
 				.endNamespace()
+				.beginNamespace("emitter")
+				.addFunction<void, RefCountedPtr<Emitter>>("add", &addEmitter)
+				.addFunction<void, RefCountedPtr<Emitter>>("remove", &removeEmitter)
+				.addFunction<RefCountedPtr<Emitter>, ULONGLONG>("get", &getEmitter)
+				.addFunction<void>("reset", &resetEmitters)
+				.addFunction<int>("count", &emitterCount)
+				.endNamespace()
+				.beginNamespace("tween")
+				.addFunction<void, RefCountedPtr<Tween>>("add", &addTween)
+				.addFunction<void, RefCountedPtr<Tween>>("remove", &removeTween)
+				.addFunction<RefCountedPtr<Tween>, ULONGLONG>("get", &getTween)
+				.addFunction<void>("reset", &resetTweens)
+				.addFunction<int>("count", &tweenCount)
+				.endNamespace()
+				.beginNamespace("easings")
+				.addConstant("linear", (UINT)Easing::Linear)
+				.addConstant("easeIn", (UINT)Easing::In)
+				.addConstant("easeOut", (UINT)Easing::Out)
+				.addConstant("easeInOut", (UINT)Easing::InOut)
+				.endNamespace()
+				.beginNamespace("properties")
+				.addConstant("position", (UINT)Property::Position)
+				.addConstant("scale", (UINT)Property::Scale)
+				.addConstant("rotation", (UINT)Property::Rotation)
+				.endNamespace()
 				.beginNamespace("sound")
 				.addFunction<void, LPCSTR>("play", &playSound)
 				.addFunction<void, LPCSTR>("loop", &loopSound)
@@ -2290,25 +7302,76 @@ namespace Flat
 	bool Engine::bRunning = false;
 	list<RefCountedPtr<Tile>> Engine::tiles = list<RefCountedPtr<Tile>>();
 	list<RefCountedPtr<Label>> Engine::labels = list<RefCountedPtr<Label>>();
+	list<RefCountedPtr<Emitter>> Engine::emitters = list<RefCountedPtr<Emitter>>();
+	list<RefCountedPtr<Tween>> Engine::tweens = list<RefCountedPtr<Tween>>();
 	float Engine::fps = 0.0f;
 	float Engine::time = 0.0f;
 	float Engine::deltaTime = 0.0f;
 	float Engine::renderTime = 0.0f;
-	Vector Engine::gravity = Vector(0.0f, -9.82f);
+	float Engine::tickRate = 0.0f;
+	float Engine::accumulator = 0.0f;
+	float Engine::alpha = 1.0f;
+	UINT Engine::maxSubsteps = 8;
 	Lua Engine::lua;
 	GLFWwindow* Engine::glWindow = nullptr;
 	bool Engine::lpKeys[GLFW_KEY_LAST + 1];
 	bool Engine::lpButtons[GLFW_MOUSE_BUTTON_LAST + 2];
 	Vector Engine::cursorPosition = Vector();
 	ULONGLONG Engine::nFrames = 0;
+	ULONGLONG Engine::nNextId = 0;
+	ULONGLONG Engine::nNextOrder = 0;
 	Transform Engine::camera = Transform();
+	Vector Engine::motion = Vector();
+	vector<RefCountedPtr<Tile>*> Engine::visibleTiles = vector<RefCountedPtr<Tile>*>();
+	UINT Engine::nVisibleTiles = 0;
+	bool Engine::headless = false;
+	UINT Engine::nOffscreenWidth = 1280;
+	UINT Engine::nOffscreenHeight = 720;
 }
 
 INT WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR nCmdLine, INT nCmdShow)
 {
+	auto flag = [&](LPCSTR lpFlag)
+		{
+			size_t nLength = strlen(lpFlag);
+
+			if (strncmp(nCmdLine, lpFlag, nLength) || (nCmdLine[nLength] && nCmdLine[nLength] != ' ' && nCmdLine[nLength] != '='))
+				return false;
+
+			nCmdLine += nLength;
+			return true;
+		};
+
+	if (flag("--benchmark"))
+	{
+		Flat::Error::bHeadless = true;
+		Flat::Physics::profile((*nCmdLine == ' ' || *nCmdLine == '=') && nCmdLine[1] ? nCmdLine + 1 : "Benchmark.json");
+		return 0;
+	}
+
+	if (flag("--headless"))
+	{
+		UINT nWidth = 1280, nHeight = 720;
+		Flat::Engine::offscreen(nWidth, nHeight);
+
+		if (*nCmdLine == '=')
+		{
+			if (sscanf_s(nCmdLine + 1, "%ux%u", &nWidth, &nHeight) != 2)
+				Flat::Error::raise("Invalid offscreen size.");
+
+			Flat::Engine::offscreen(nWidth, nHeight);
+			nCmdLine = strchr(nCmdLine, ' ') ? strchr(nCmdLine, ' ') : nCmdLine + strlen(nCmdLine);
+		}
+
+		while (*nCmdLine == ' ')
+			nCmdLine++;
+	}
+
 	if (!strlen(nCmdLine))
 		if (std::filesystem::exists("Main.lua"))
 			nCmdLine = (LPSTR)"Main.lua";
+		else if (Flat::Error::bHeadless)
+			Flat::Error::raise("No game script given.");
 		else
 			nCmdLine = (LPSTR)Flat::Explorer::select("Lua (*.lua)\0*.lua\0\0");
 